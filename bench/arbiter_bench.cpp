@@ -0,0 +1,190 @@
+// Microbenchmarks of the arbitration backends, built from the program's own translation unit
+// with its main() compiled out:
+//
+//   RoundTrip   pickup()+putdown() back to back by 1, 2, 4 or 8 threads on adjacent seats of a
+//               64-seat ring; one thread is the uncontended cost, more add neighbours contending
+//   Wakeup      from a putdown() to the return of the neighbour's pickup() parked behind it,
+//               the grant -> cv (or wake word, or semaphore) -> running path; manual time
+//   QueueDepth  one arbitration pass over d waiters that cannot eat, for the arbiters that keep
+//               a wait queue; FIFO looks at the front only, SCAN and BULK at every waiter
+//
+// Build with cmake (see CMakeLists.txt) and run build/arbiter_bench, optionally with
+// --benchmark_filter=RoundTrip/monitor etc.
+#define FILOZOFOWIE_NO_MAIN
+#include "filozofowie.cpp"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+struct Backend {
+    ArbiterKind kind;
+    QueuePolicy queue = QueuePolicy::FIFO;
+};
+
+const Backend backends[] = {
+    {ArbiterKind::MONITOR, QueuePolicy::FIFO},
+    {ArbiterKind::MONITOR, QueuePolicy::SCAN},
+    {ArbiterKind::MONITOR, QueuePolicy::BULK},
+    {ArbiterKind::FIXED},
+    {ArbiterKind::SHARDED},
+    {ArbiterKind::ATOMIC},
+    {ArbiterKind::HIERARCHY},
+    {ArbiterKind::WAITER},
+    {ArbiterKind::CHANDY_MISRA},
+};
+
+constexpr int ring = 64;        // RoundTrip, Wakeup; a fixed_size() so fixed<64> takes part
+constexpr int deep_ring = 1024; // QueueDepth: room for 341 blocked waiters
+
+Options bench_options(const Backend& b, int n) {
+    Options opt;
+    opt.n = n;
+    opt.bench = true;
+    opt.arbiter = b.kind;
+    opt.queue = b.queue;
+    return opt;
+}
+
+struct Table {
+    std::atomic<bool> running{true};
+    std::unique_ptr<Arbiter> arbiter;
+
+    Table(const Backend& b, int n) : arbiter(make_local_arbiter(bench_options(b, n), running)) {}
+
+    ~Table() {
+        running = false;
+        arbiter->stop();
+    }
+};
+
+long long steady_ns() {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+void round_trip(benchmark::State& state, Backend b) {
+    // Shared by the benchmark's threads. Thread 0 builds it before the loop and destroys it after;
+    // every thread passes a barrier on entering and leaving the loop.
+    static Table* table = nullptr;
+    if (state.thread_index() == 0) table = new Table(b, ring);
+    int seat = state.thread_index();
+    for (auto _ : state) {
+        table->arbiter->pickup(seat);
+        table->arbiter->putdown(seat);
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        delete table;
+        table = nullptr;
+    }
+}
+
+void wakeup(benchmark::State& state, Backend b) {
+    // Seat 0 eats while seat 1, on another thread, gets hungry and parks; the time from seat 0's
+    // putdown() to seat 1 running again is the iteration's time. Seat 1 is given settle to reach
+    // its blocking wait first, which is longer than any backend's spin before parking.
+    constexpr auto settle = std::chrono::microseconds(200);
+    Table table(b, ring);
+    Arbiter& arbiter = *table.arbiter;
+    std::atomic<int> round{0}, hungry{0}, done{0};
+    std::atomic<long long> woke{0};
+    std::thread neighbour([&] {
+        for (int r = 1;; r++) {
+            while (round.load() < r) {
+                if (!table.running.load()) return;
+                std::this_thread::yield();
+            }
+            hungry.store(r);
+            arbiter.pickup(1);
+            woke.store(steady_ns());
+            arbiter.putdown(1);
+            done.store(r);
+        }
+    });
+    long parks = arbiter.wait_counts().parks;
+    int r = 0;
+    for (auto _ : state) {
+        arbiter.pickup(0);
+        round.store(++r);
+        while (hungry.load() < r) std::this_thread::yield();
+        std::this_thread::sleep_for(settle);
+        long long start = steady_ns();
+        arbiter.putdown(0);
+        while (done.load() < r) std::this_thread::yield();
+        state.SetIterationTime((double)(woke.load() - start) / 1e9);
+    }
+    // Only the arbiters that count parks report them; 1 means every wakeup took the slow path
+    state.counters["parks"] = benchmark::Counter((double)(arbiter.wait_counts().parks - parks), benchmark::Counter::kAvgIterations);
+    table.running = false;
+    neighbour.join();
+}
+
+} // namespace
+
+// Reaches into the queue-owning arbiters, which declare it a friend. Fills the queue with depth
+// waiters that cannot eat (seats 3k eat, 3k + 1 wait behind them) and times the arbitration
+// pass putdown() and request() run, under the monitor lock held for the whole loop.
+struct ArbiterProbe {
+    template <class A>
+    static void fill(A& arbiter, int depth) {
+        for (int k = 0; k < depth; k++) arbiter.request(3 * k);
+        for (int k = 0; k < depth; k++) arbiter.request(3 * k + 1);
+    }
+
+    static void pass(benchmark::State& state, MonitorArbiter& arbiter) {
+        std::vector<int> woken;
+        SiteLock lock(arbiter.mtx, LockSite::PUTDOWN);
+        for (auto _ : state) arbiter.arbitrate(woken);
+        if (!woken.empty()) state.SkipWithError("a queued waiter could eat");
+    }
+
+    template <int N>
+    static void pass(benchmark::State& state, FixedMonitorArbiter<N>& arbiter) {
+        std::vector<int> woken;
+        SiteLock lock(arbiter.mtx, LockSite::PUTDOWN);
+        for (auto _ : state) arbiter.test_front(woken);
+        if (!woken.empty()) state.SkipWithError("a queued waiter could eat");
+    }
+};
+
+namespace {
+
+void queue_depth(benchmark::State& state, Backend b) {
+    Table table(b, deep_ring);
+    int depth = (int)state.range(0);
+    if (auto* monitor = dynamic_cast<MonitorArbiter*>(table.arbiter.get())) {
+        ArbiterProbe::fill(*monitor, depth);
+        ArbiterProbe::pass(state, *monitor);
+    } else if (auto* fixed = dynamic_cast<FixedMonitorArbiter<deep_ring>*>(table.arbiter.get())) {
+        ArbiterProbe::fill(*fixed, depth);
+        ArbiterProbe::pass(state, *fixed);
+    }
+    state.counters["depth"] = depth;
+}
+
+bool has_queue(const Backend& b) {
+    return b.kind == ArbiterKind::MONITOR || b.kind == ArbiterKind::FIXED;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::atomic<bool> idle{false};
+    for (const Backend& b : backends) {
+        std::string name = make_local_arbiter(bench_options(b, ring), idle)->name();
+        benchmark::RegisterBenchmark(("RoundTrip/" + name).c_str(), round_trip, b)
+            ->Threads(1)->Threads(2)->Threads(4)->Threads(8)->UseRealTime();
+        benchmark::RegisterBenchmark(("Wakeup/" + name).c_str(), wakeup, b)
+            ->UseManualTime()->Iterations(2000)->Unit(benchmark::kMicrosecond);
+        if (has_queue(b)) {
+            std::string deep = make_local_arbiter(bench_options(b, deep_ring), idle)->name();
+            benchmark::RegisterBenchmark(("QueueDepth/" + deep).c_str(), queue_depth, b)
+                ->Arg(1)->Arg(16)->Arg(64)->Arg(256);
+        }
+    }
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -9,181 +9,5520 @@
 #include <atomic>
 #include <csignal>
 #include <deque>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <functional>
+#include <coroutine>
+#include <exception>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <bit>
+#include <bitset>
+#include <array>
+#include <semaphore>
+#include <latch>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <filesystem>
+#include <tuple>
+#include <cctype>
+#include <queue>
+#include <climits>
+#include <sstream>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <cerrno>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
 enum State { THINKING, HUNGRY, EATING };
 
-class DiningPhilosophers {
+enum class QueuePolicy {
+    FIFO, // serve wait_queue strictly from the front
+    SCAN, // grant every waiter whose forks are free, bounded by bypass_limit
+    BULK  // SCAN's decisions, visiting only the waiters a bitmask pass finds eligible
+};
+
+enum class WaitPolicy {
+    PARK,    // block on the condition variable as soon as the forks are not free
+    ADAPTIVE // spin first for as long as the neighbours have recently held their forks
+};
+
+enum class ArbiterKind {
+    MONITOR, // one monitor lock and one wait queue for the whole table
+    SHARDED, // one lock per ring segment, neighbours ordered by hunger age
+    ATOMIC,       // forks claimed with CAS, no lock; waiters park on a per-philosopher word
+    HIERARCHY,    // one lock per fork, taken lower-numbered fork first (Dijkstra)
+    WAITER,       // one lock per fork behind n-1 seat tokens
+    CHANDY_MISRA, // dirty/clean forks handed over on request
+    FIXED         // the FIFO monitor specialised for a ring size known at compile time
+};
+
+// Ring sizes FixedMonitorArbiter is instantiated for
+static bool fixed_size(int n) { return n == 5 || n == 64 || n == 1024; }
+
+// Arbiters whose pickup() can only block, so they need one thread per philosopher
+static bool blocking_only(ArbiterKind kind) {
+    return kind == ArbiterKind::ATOMIC || kind == ArbiterKind::HIERARCHY || kind == ArbiterKind::WAITER;
+}
+
+enum class Layout {
+    PACKED, // per-philosopher records back to back, neighbours share cache lines
+    PADDED  // every record starts on its own cache line
+};
+
+enum class ExecMode {
+    THREADS, // one std::thread per philosopher blocking in pickup()
+    POOL,    // philosophers are state machines stepped by a fixed pool of workers
+    CORO,    // philosophers are coroutines resumed by a fixed pool of workers
+    SIM      // the POOL state machines stepped by one thread from an event queue in virtual time
+};
+
+enum class WorkKind {
+    SLEEP, // wait the eat time out, leaving the core idle
+    SPIN,  // keep the core busy with arithmetic for the eat time
+    TOUCH  // write every cache line of both forks' buffers, once and then until the eat time is up
+};
+
+// Count of every heap allocation the process makes, so the bench can show that a meal does not
+// allocate. Replacing the global operator new costs one uncontended relaxed add per allocation.
+// What the bench's own sample vectors allocate while a thread is inside a SampleAllocations
+// scope is counted apart in sample_allocations, since those vectors exist only to report on it.
+static std::atomic<unsigned long long> heap_allocations{0};
+static std::atomic<unsigned long long> sample_allocations{0};
+static thread_local bool in_sample_scope = false;
+
+struct SampleAllocations {
+    SampleAllocations() { in_sample_scope = true; }
+    ~SampleAllocations() { in_sample_scope = false; }
+};
+
+static void count_allocation() {
+    (in_sample_scope ? sample_allocations : heap_allocations).fetch_add(1, std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    count_allocation();
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    count_allocation();
+    size_t a = (size_t)align;
+    if (void* p = std::aligned_alloc(a, (std::max<size_t>(size, 1) + a - 1) / a * a)) return p;
+    throw std::bad_alloc();
+}
+
+// Not inlined, or GCC sees free() applied to memory from operator new and warns
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+
+// xoshiro256** seeded through splitmix64, one per philosopher so sampling never contends
+class Rng {
+public:
+    explicit Rng(uint64_t seed = 0) {
+        for (auto& w : s) w = splitmix64(seed);
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    double uniform() { return (double)(next() >> 11) * 0x1.0p-53; } // [0, 1)
+
+    static uint64_t splitmix64(uint64_t& x) {
+        uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+// Parses "250", "250us", "1.5ms", "2s" or "800ns"; a bare number is microseconds
+static long long parse_duration_ns(const std::string& text) {
+    size_t used = 0;
+    double value = std::stod(text, &used);
+    std::string unit = text.substr(used);
+    double scale = 1e3;
+    if (unit == "ns") scale = 1;
+    else if (unit == "us" || unit.empty()) scale = 1e3;
+    else if (unit == "ms") scale = 1e6;
+    else if (unit == "s") scale = 1e9;
+    else throw std::invalid_argument("unknown time unit in " + text);
+    if (value < 0) throw std::invalid_argument("negative duration " + text);
+    return (long long)std::llround(value * scale);
+}
+
+// Parses "4096", "64k", "1m" or "1g" (powers of 1024)
+static size_t parse_bytes(const std::string& text) {
+    size_t used = 0;
+    unsigned long long value = std::stoull(text, &used);
+    std::string unit = text.substr(used);
+    int shift = 0;
+    if (unit == "k" || unit == "K") shift = 10;
+    else if (unit == "m" || unit == "M") shift = 20;
+    else if (unit == "g" || unit == "G") shift = 30;
+    else if (!unit.empty()) throw std::invalid_argument("unknown size unit in " + text);
+    if (value > (SIZE_MAX >> shift)) throw std::out_of_range("size too large: " + text);
+    return (size_t)(value << shift);
+}
+
+static std::string format_duration(long long ns) {
+    char buf[32];
+    if (ns == 0) return "0";
+    if (ns % 1000000000 == 0) std::snprintf(buf, sizeof buf, "%llds", ns / 1000000000);
+    else if (ns % 1000000 == 0) std::snprintf(buf, sizeof buf, "%lldms", ns / 1000000);
+    else if (ns % 1000 == 0) std::snprintf(buf, sizeof buf, "%lldus", ns / 1000);
+    else std::snprintf(buf, sizeof buf, "%lldns", ns);
+    return buf;
+}
+
+// Think or eat duration distribution, parsed from fixed:D, uniform:LO:HI, exp:MEAN or
+// trace:FILE (one duration per line, replayed in order and wrapped around)
+struct Distribution {
+    enum Kind { FIXED, UNIFORM, EXPONENTIAL, TRACE };
+
+    Kind kind = FIXED;
+    long long lo_ns = 0; // FIXED value, UNIFORM lower bound, EXPONENTIAL mean
+    long long hi_ns = 0; // UNIFORM upper bound (exclusive)
+    std::string path;    // TRACE
+    std::shared_ptr<const std::vector<long long>> trace;
+
+    static Distribution fixed(long long ns) {
+        Distribution d;
+        d.lo_ns = ns;
+        return d;
+    }
+
+    static Distribution uniform(long long lo, long long hi) {
+        Distribution d;
+        d.kind = UNIFORM;
+        d.lo_ns = lo;
+        d.hi_ns = hi;
+        return d;
+    }
+
+    static Distribution parse(const std::string& spec) {
+        size_t colon = spec.find(':');
+        std::string kind = spec.substr(0, colon);
+        std::string rest = colon == std::string::npos ? "" : spec.substr(colon + 1);
+        if (kind == "fixed") return fixed(parse_duration_ns(rest));
+        if (kind == "uniform") {
+            size_t sep = rest.find(':');
+            if (sep == std::string::npos) throw std::invalid_argument("uniform needs LO:HI in " + spec);
+            Distribution d = uniform(parse_duration_ns(rest.substr(0, sep)), parse_duration_ns(rest.substr(sep + 1)));
+            if (d.hi_ns <= d.lo_ns) throw std::invalid_argument("uniform needs LO < HI in " + spec);
+            return d;
+        }
+        if (kind == "exp") {
+            Distribution d;
+            d.kind = EXPONENTIAL;
+            d.lo_ns = parse_duration_ns(rest);
+            return d;
+        }
+        if (kind == "trace") {
+            Distribution d;
+            d.kind = TRACE;
+            d.path = rest;
+            auto samples = std::make_shared<std::vector<long long>>();
+            std::ifstream in(rest);
+            if (!in) throw std::invalid_argument("cannot open trace " + rest);
+            std::string line;
+            while (std::getline(in, line)) {
+                if (line.empty() || line[0] == '#') continue;
+                samples->push_back(parse_duration_ns(line));
+            }
+            if (samples->empty()) throw std::invalid_argument("trace " + rest + " has no durations");
+            d.trace = samples;
+            return d;
+        }
+        throw std::invalid_argument("unknown distribution " + spec);
+    }
+
+    // cursor is the sampling philosopher's position in the trace
+    std::chrono::nanoseconds sample(Rng& rng, size_t& cursor) const {
+        switch (kind) {
+        case FIXED: return std::chrono::nanoseconds(lo_ns);
+        case UNIFORM: return std::chrono::nanoseconds(lo_ns + (long long)(rng.uniform() * (double)(hi_ns - lo_ns)));
+        case EXPONENTIAL: return std::chrono::nanoseconds((long long)(-(double)lo_ns * std::log1p(-rng.uniform())));
+        case TRACE: return std::chrono::nanoseconds((*trace)[cursor++ % trace->size()]);
+        }
+        return std::chrono::nanoseconds(0);
+    }
+
+    std::string describe() const {
+        switch (kind) {
+        case FIXED: return "fixed " + format_duration(lo_ns);
+        case UNIFORM: return "uniform " + format_duration(lo_ns) + ".." + format_duration(hi_ns);
+        case EXPONENTIAL: return "exp mean " + format_duration(lo_ns);
+        case TRACE: return "trace " + path + " (" + std::to_string(trace->size()) + " samples)";
+        }
+        return "";
+    }
+};
+
+struct Options {
+    int n = 0;
+    bool bench = false;      // headless: no ncurses, report throughput/latency at exit
+    double duration_s = 5.0; // bench stops after this long...
+    long meals = 0;          // ...or after this many meals in total, if non-zero
+    Distribution think = Distribution::uniform(1000000000LL, 3000000000LL);
+    Distribution eat = Distribution::uniform(500000000LL, 1500000000LL);
+    uint64_t seed = 0;       // base of every philosopher's RNG; 0 picks one from the clock
+    QueuePolicy queue = QueuePolicy::FIFO;
+    int bypass_limit = 4;    // SCAN, SHARDED: how many times a waiter may be overtaken by a neighbour
+    ArbiterKind arbiter = ArbiterKind::MONITOR;
+    bool all_arbiters = false; // bench: run every arbiter in turn and compare them
+    bool quiet = false;        // sweep: fill the bench summary without printing it or taking SIGINT
+    bool samples = true;       // bench: keep every wait for exact percentiles; off in the
+                               // partitions of an interactive run, which only publish histograms
+    int shards = 8;          // SHARDED: number of ring segments, capped at n / 6
+    int spin = 200;          // ATOMIC: claim attempts before parking
+    WaitPolicy wait = WaitPolicy::PARK; // MONITOR, SHARDED
+    int spin_limit_us = 50;  // ADAPTIVE: park at once when the expected wait is longer than this
+    ExecMode exec = ExecMode::THREADS;
+    int workers = 0;         // POOL, CORO: worker threads, 0 means one per core
+    int tick_us = 100;       // POOL, CORO: timer wheel resolution
+    Layout layout = Layout::PADDED;
+    bool pin = false;        // pin philosophers (or pool workers) so ring segments share a core, L3 and node
+    std::string trace_path;  // record arbiter events to this file
+    int metrics_port = 0;    // serve Prometheus metrics over HTTP on this port, 0 disables
+    int partitions = 1;      // processes the ring is split across, each with its own arbiter
+    std::string publish_path; // publish the live table to this file for --view instead of drawing it
+    std::string record_path;  // write the drawn durations and the grant order to this file
+    std::string replay_path;  // take think and eat durations from this recording instead
+    int capacity = 0;         // seats for philosophers added while running; 0 keeps the ring at n
+    WorkKind work = WorkKind::SLEEP; // what eating does for the drawn eat time
+    size_t touch_bytes = 4096;       // TOUCH: buffer per fork
+};
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+#ifdef __cpp_lib_hardware_interference_size
+constexpr size_t cache_line = std::hardware_destructive_interference_size;
+#else
+constexpr size_t cache_line = 64;
+#endif
+
+// CPUs this process may run on, read from sysfs and ordered so that neighbours in the list share
+// a core, then a last-level cache, then a NUMA node. Missing sysfs entries count as shared.
+struct Topology {
+    struct Cpu {
+        int id = 0;
+        int node = 0;
+        int llc = 0;  // lowest CPU sharing the last-level cache
+        int core = 0; // package and core id
+    };
+
+    std::vector<Cpu> cpus;
+    int nodes = 1;
+
+    static std::vector<int> parse_cpulist(const std::string& text) {
+        // "0-3,8,10-11"
+        std::vector<int> ids;
+        size_t at = 0;
+        while (at < text.size()) {
+            size_t end = text.find(',', at);
+            if (end == std::string::npos) end = text.size();
+            std::string range = text.substr(at, end - at);
+            size_t dash = range.find('-');
+            try {
+                int lo = std::stoi(range), hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+                for (int c = lo; c <= hi; c++) ids.push_back(c);
+            } catch (const std::exception&) {}
+            at = end + 1;
+        }
+        return ids;
+    }
+
+    static std::string read_line(const std::string& path) {
+        std::ifstream in(path);
+        std::string line;
+        std::getline(in, line);
+        return line;
+    }
+
+    static int read_int(const std::string& path, int fallback) {
+        try {
+            return std::stoi(read_line(path));
+        } catch (const std::exception&) {
+            return fallback;
+        }
+    }
+
+    static Topology detect() {
+        Topology t;
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) CPU_SET(0, &allowed);
+        std::vector<int> node_of(CPU_SETSIZE, 0);
+        std::error_code ec;
+        int max_node = 0;
+        for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec)) {
+            std::string name = entry.path().filename().string();
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4 || !std::isdigit((unsigned char)name[4])) continue;
+            int node = std::stoi(name.substr(4));
+            max_node = std::max(max_node, node);
+            for (int c : parse_cpulist(read_line(entry.path().string() + "/cpulist"))) {
+                if (c >= 0 && c < CPU_SETSIZE) node_of[c] = node;
+            }
+        }
+        t.nodes = max_node + 1;
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (!CPU_ISSET(c, &allowed)) continue;
+            std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(c);
+            Cpu cpu;
+            cpu.id = c;
+            cpu.node = node_of[c];
+            std::vector<int> llc = parse_cpulist(read_line(dir + "/cache/index3/shared_cpu_list"));
+            if (llc.empty()) llc = parse_cpulist(read_line(dir + "/cache/index2/shared_cpu_list"));
+            cpu.llc = llc.empty() ? cpu.node : llc.front();
+            cpu.core = read_int(dir + "/topology/physical_package_id", 0) * 65536 + read_int(dir + "/topology/core_id", c);
+            t.cpus.push_back(cpu);
+        }
+        std::sort(t.cpus.begin(), t.cpus.end(), [](const Cpu& a, const Cpu& b) {
+            return std::tie(a.node, a.llc, a.core, a.id) < std::tie(b.node, b.llc, b.core, b.id);
+        });
+        return t;
+    }
+};
+
+// Splits the ring into contiguous segments, one per CPU in topology order, so that philosophers
+// sharing a fork share a core or at least a cache and a node. While a Placement is active, every
+// per-philosopher RecordArray moves its pages to the node of the philosophers stored on them.
+class Placement {
+public:
+    static const Placement* active;
+
+    Placement(const Topology& t, int num) : topology(t), n(num) {}
+
+    const Topology::Cpu& cpu_of(int i) const { return topology.cpus[(size_t)((long long)i * (long long)topology.cpus.size() / n)]; }
+
+    // Worker w of a pool of the given size; workers are spread over the CPUs in the same order
+    const Topology::Cpu& cpu_of_worker(int w, int workers) const {
+        return topology.cpus[(size_t)((long long)w * (long long)topology.cpus.size() / workers) % topology.cpus.size()];
+    }
+
+    static void pin_current_thread(int cpu) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+    }
+
+    // Moves the pages of count records of stride bytes at storage to their philosopher's node
+    void bind(char* storage, int count, size_t stride) const {
+        if (count != n || topology.nodes < 2) return;
+        const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (uintptr_t)storage & ~(page - 1), end = (uintptr_t)storage + (uintptr_t)count * stride;
+        std::vector<void*> pages;
+        std::vector<int> nodes;
+        for (uintptr_t a = begin; a < end; a += page) {
+            // The first record that starts on this page, or the one running into it
+            uintptr_t offset = a > (uintptr_t)storage ? a - (uintptr_t)storage : 0;
+            int first = (int)std::min<uintptr_t>((offset + stride - 1) / stride, (uintptr_t)count - 1);
+            pages.push_back((void*)a);
+            nodes.push_back(cpu_of(first).node);
+        }
+        std::vector<int> status(pages.size(), 0);
+        constexpr int move_flag = 1 << 1; // MPOL_MF_MOVE
+        if (syscall(SYS_move_pages, 0, (unsigned long)pages.size(), pages.data(), nodes.data(), status.data(), move_flag) != 0) return;
+        for (size_t k = 0; k < pages.size(); k++) {
+            if (status[k] == nodes[k]) pages_placed.fetch_add(1, std::memory_order_relaxed);
+        }
+        pages_total.fetch_add((long)pages.size(), std::memory_order_relaxed);
+    }
+
+    // One line per CPU: which philosophers run there
+    std::string describe() const {
+        std::string out;
+        char line[128];
+        std::snprintf(line, sizeof line, "placement        %d philosophers on %zu cpus, %d numa nodes\n", n, topology.cpus.size(), topology.nodes);
+        out += line;
+        for (int i = 0; i < n;) {
+            int j = i;
+            while (j + 1 < n && cpu_of(j + 1).id == cpu_of(i).id) j++;
+            const Topology::Cpu& c = cpu_of(i);
+            std::snprintf(line, sizeof line, "  cpu %3d (node %d, llc %d): philosophers %d-%d\n", c.id, c.node, c.llc, i, j);
+            out += line;
+            i = j + 1;
+        }
+        if (topology.nodes > 1) {
+            std::snprintf(line, sizeof line, "  records on local node: %ld of %ld pages\n", pages_placed.load(), pages_total.load());
+            out += line;
+        }
+        return out;
+    }
+
 private:
+    Topology topology;
     int n;
+    mutable std::atomic<long> pages_placed{0};
+    mutable std::atomic<long> pages_total{0};
+};
+
+const Placement* Placement::active = nullptr;
+
+// Fixed-size array of per-philosopher records laid out according to Layout. The stride is a
+// runtime value so the bench can compare both layouts with the same build.
+template <class T>
+class RecordArray {
+public:
+    RecordArray(int n, Layout layout)
+        : count(n), stride(layout == Layout::PADDED ? (sizeof(T) + cache_line - 1) / cache_line * cache_line : sizeof(T)),
+          storage(static_cast<char*>(::operator new((size_t)n * stride, std::align_val_t(cache_line)))) {
+        for (int i = 0; i < count; i++) new (storage + (size_t)i * stride) T();
+        if (Placement::active) Placement::active->bind(storage, count, stride);
+    }
+
+    ~RecordArray() {
+        for (int i = 0; i < count; i++) (*this)[i].~T();
+        ::operator delete(storage, std::align_val_t(cache_line));
+    }
+
+    RecordArray(const RecordArray&) = delete;
+    RecordArray& operator=(const RecordArray&) = delete;
+
+    T& operator[](int i) { return *std::launder(reinterpret_cast<T*>(storage + (size_t)i * stride)); }
+    const T& operator[](int i) const { return *std::launder(reinterpret_cast<const T*>(storage + (size_t)i * stride)); }
+    int size() const { return count; }
+
+private:
+    int count;
+    size_t stride;
+    char* storage;
+};
+
+// Links of a WaitList, embedded in the record of every philosopher that can be queued
+struct QueueLink {
+    int prev = -1;
+    int next = -1;
+    bool queued = false;
+};
+
+// Doubly linked queue of philosopher ids threaded through the `link` member of their records,
+// so queueing never allocates. Push, pop and removal from the middle are all O(1).
+template <class T, class Records = RecordArray<T>>
+class WaitList {
+public:
+    explicit WaitList(Records& r) : records(r) {}
+
+    bool empty() const { return head < 0; }
+    bool contains(int i) const { return records[i].link.queued; }
+    int front() const { return head; }
+    int next(int i) const { return records[i].link.next; } // -1 after the last one
+
+    void push_back(int i) {
+        QueueLink& l = records[i].link;
+        l.prev = tail;
+        l.next = -1;
+        l.queued = true;
+        if (tail >= 0) records[tail].link.next = i;
+        else head = i;
+        tail = i;
+    }
+
+    void remove(int i) {
+        QueueLink& l = records[i].link;
+        if (l.prev >= 0) records[l.prev].link.next = l.next;
+        else head = l.next;
+        if (l.next >= 0) records[l.next].link.prev = l.prev;
+        else tail = l.prev;
+        l = QueueLink();
+    }
+
+private:
+    Records& records;
+    int head = -1;
+    int tail = -1;
+};
+
+// Copy of the table taken by the renderer; the arbiter fills it consistently
+struct TableView {
     std::vector<State> state;
     std::vector<int> eat_count;
     std::vector<int> think_count;
-    std::vector<int> fork_owner; // -1 free, otherwise philosopher id holding both adjacent forks
-    std::vector<bool> in_queue;
-    std::deque<int> wait_queue; // FIFO to avoid starvation
-    std::vector<std::condition_variable> cv;
-    std::mutex mtx; // monitor lock guarding state/cv
-    std::mutex display_mutex;
-    std::atomic<bool> running;
+    std::vector<int> fork_owner;
+    std::vector<int> queue; // waiters, first to be served first
+
+    // Filled by the driver from its per-philosopher histograms, not by the arbiter
+    std::vector<long long> wait_p50, wait_p99; // ns spent HUNGRY
+    std::vector<long long> hold_p50, hold_p99; // ns the forks were held
+    long long depth_p50 = 0, depth_p99 = 0;    // sampled waiting queue length
+
+    // Scratch space of SnapshotBoard::read(), kept here so that taking a snapshot does not allocate
+    std::vector<long long> line;
+    std::vector<std::pair<long long, int>> waiting;
+    std::vector<std::pair<int, int>> ranked; // the same for the partitioned table
+};
+
+// Atomic with relaxed loads/stores and the plain-value syntax of the field it replaces. Writers
+// must already be serialised by the owning arbiter lock; readers may load at any time.
+template <class T>
+class Relaxed {
+public:
+    Relaxed(T x = T()) : v(x) {}
+    Relaxed(const Relaxed& o) : v(o.load()) {}
+    Relaxed& operator=(const Relaxed& o) { v.store(o.load(), std::memory_order_relaxed); return *this; }
+    Relaxed& operator=(T x) { v.store(x, std::memory_order_relaxed); return *this; }
+    Relaxed& operator++() { v.store(v.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); return *this; }
+    operator T() const { return load(); }
+    T load() const { return v.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<T> v;
+};
+
+// Lock contention profile, compiled in with -DLOCK_PROFILE. Without it every hook below is an
+// empty if constexpr branch, so the arbiters' locks cost what they did before.
+#ifdef LOCK_PROFILE
+constexpr bool lock_profile = true;
+#else
+constexpr bool lock_profile = false;
+#endif
+
+// Callers an arbiter lock is taken for. The display takes no arbiter lock, so it has no site.
+enum class LockSite : uint8_t { PICKUP, PUTDOWN, STOP, COUNT };
+
+// Per-thread counters of arbiter lock acquisitions, wait and hold time, by call site. Every
+// thread writes only its own block, registered on its first acquisition; a block is handed to
+// a later thread once its owner exits, keeping what it counted. totals() sums every block.
+class LockProfile {
+public:
+    struct Site {
+        uint64_t acquisitions = 0;
+        uint64_t handoffs = 0; // acquisitions from a lock another thread held last
+        long long wait_ns = 0; // blocked in lock(); only counted when try_lock failed
+        long long hold_ns = 0; // lock() to unlock(), less time parked on a condition variable
+    };
+
+    struct Totals {
+        Site sites[(int)LockSite::COUNT];
+        uint64_t acquisitions() const {
+            uint64_t total = 0;
+            for (const Site& s : sites) total += s.acquisitions;
+            return total;
+        }
+    };
+
+    static constexpr const char* site_names[] = {"pickup", "putdown", "stop"};
+
+    struct Block {
+        struct Counters {
+            Relaxed<uint64_t> acquisitions{0}, handoffs{0};
+            Relaxed<long long> wait_ns{0}, hold_ns{0};
+        };
+        Counters sites[(int)LockSite::COUNT];
+        int index = 0;
+
+        void acquired(LockSite site, long long wait, bool handoff) {
+            Counters& c = sites[(int)site];
+            ++c.acquisitions;
+            if (handoff) ++c.handoffs;
+            if (wait) c.wait_ns = c.wait_ns + wait;
+        }
+        void held(LockSite site, long long ns) { sites[(int)site].hold_ns = sites[(int)site].hold_ns + ns; }
+    };
+
+    static Block& local() {
+        thread_local Handle handle;
+        return *handle.block;
+    }
+
+    static Totals totals() {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        Totals t;
+        for (auto& b : blocks) {
+            for (int k = 0; k < (int)LockSite::COUNT; k++) {
+                t.sites[k].acquisitions += b->sites[k].acquisitions;
+                t.sites[k].handoffs += b->sites[k].handoffs;
+                t.sites[k].wait_ns += b->sites[k].wait_ns;
+                t.sites[k].hold_ns += b->sites[k].hold_ns;
+            }
+        }
+        return t;
+    }
+
+    // Zeroes every block; only while no other thread takes an arbiter lock
+    static void reset() {
+        std::lock_guard<std::mutex> lock(registry_mtx);
+        for (auto& b : blocks) {
+            for (auto& c : b->sites) c = Block::Counters();
+        }
+    }
+
+private:
+    struct Handle {
+        Block* block;
+        Handle() {
+            std::lock_guard<std::mutex> lock(registry_mtx);
+            if (!free_blocks.empty()) {
+                block = free_blocks.back();
+                free_blocks.pop_back();
+            } else {
+                blocks.push_back(std::make_unique<Block>());
+                block = blocks.back().get();
+                block->index = (int)blocks.size();
+            }
+        }
+        ~Handle() {
+            std::lock_guard<std::mutex> lock(registry_mtx);
+            free_blocks.push_back(block);
+        }
+    };
+
+    static inline std::mutex registry_mtx;
+    static inline std::vector<std::unique_ptr<Block>> blocks;
+    static inline std::vector<Block*> free_blocks;
+};
+
+// std::mutex that adds up how long lock() had to wait. The uncontended path is a try_lock, as
+// cheap as a plain lock(); only a failed try_lock reads the clock. Every lock names its call
+// site, which only a LOCK_PROFILE build records. Hold it through a SiteLock, which can also wait
+// on a condition variable.
+class CountingMutex {
+public:
+    void lock(LockSite site) {
+        if (m.try_lock()) {
+            acquired(site, 0);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        m.lock();
+        long long wait = (std::chrono::steady_clock::now() - start).count();
+        waited.fetch_add(wait, std::memory_order_relaxed);
+        acquired(site, wait);
+    }
+    void unlock() {
+        suspend();
+        m.unlock();
+    }
+    std::mutex& native() { return m; }
+    long long waited_ns() const { return waited.load(std::memory_order_relaxed); }
+
+    // Brackets a condition variable wait on native(), during which the lock is not held
+    template <bool profile = lock_profile>
+    void suspend() {
+        if constexpr (profile) {
+            HolderOf<profile>& h = holder;
+            LockProfile::local().held(h.site, std::chrono::steady_clock::now().time_since_epoch().count() - h.since);
+        }
+    }
+    void resume(LockSite s) { acquired(s, 0); }
+
+private:
+    // The last holder, written by it; a LOCK_PROFILE build's only, takes no room otherwise
+    struct Holder {
+        int block = 0; // LockProfile block of the last holder
+        LockSite site = LockSite::PICKUP;
+        long long since = 0;
+    };
+    struct NoHolder {};
+    template <bool profile>
+    using HolderOf = std::conditional_t<profile, Holder, NoHolder>;
+
+    std::mutex m;
+    std::atomic<long long> waited{0};
+    [[no_unique_address]] HolderOf<lock_profile> holder;
+
+    // suspend() and acquired() reach holder through a HolderOf<profile>, so that without
+    // LOCK_PROFILE their discarded branches never name Holder's fields
+    template <bool profile = lock_profile>
+    void acquired(LockSite s, long long wait) {
+        if constexpr (profile) {
+            HolderOf<profile>& h = holder;
+            LockProfile::Block& me = LockProfile::local();
+            me.acquired(s, wait, h.block != 0 && h.block != me.index);
+            h.block = me.index;
+            h.site = s;
+            h.since = std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+    }
+};
+
+static_assert(lock_profile || sizeof(CountingMutex) == sizeof(std::mutex) + sizeof(std::atomic<long long>));
+
+// Holds a CountingMutex for one call site, like a std::unique_lock that condition variables
+// wait on through wait(). Time spent parked counts as neither waiting for nor holding the lock.
+class SiteLock {
+public:
+    SiteLock(CountingMutex& m, LockSite s) : mtx(m), site(s) { lock(); }
+    ~SiteLock() {
+        if (owned) mtx.unlock();
+    }
+    SiteLock(const SiteLock&) = delete;
+    SiteLock& operator=(const SiteLock&) = delete;
+
+    void lock() {
+        mtx.lock(site);
+        owned = true;
+    }
+    void unlock() {
+        owned = false;
+        mtx.unlock();
+    }
+
+    template <class Predicate>
+    void wait(std::condition_variable& cv, Predicate ready) {
+        mtx.suspend();
+        std::unique_lock<std::mutex> native(mtx.native(), std::adopt_lock);
+        cv.wait(native, ready);
+        native.release();
+        mtx.resume(site);
+    }
+
+private:
+    CountingMutex& mtx;
+    LockSite site;
+    bool owned = false;
+};
+
+// Spin budget for arbiters that park on a condition variable. A waiter spins for twice the recent
+// fork hold time of its neighbours when that is below the limit, and parks at once when longer
+// holds are expected, or when every other core already has a spinner, so that spinning never
+// takes the CPU away from the philosopher it waits for. Hold times are learned as an average
+// with weight 1/8 on the newest sample.
+class AdaptiveSpin {
+public:
+    explicit AdaptiveSpin(long long limit_ns)
+        : limit(limit_ns), max_spinners((int)std::thread::hardware_concurrency() - 1) {}
+
+    static void learn(Relaxed<long long>& average, long long hold_ns) {
+        average = average.load() + (hold_ns - average.load()) / 8;
+    }
+
+    // Spins until done() or the budget for expected_ns runs out; true if done() came true
+    template <class Done>
+    bool spin(long long expected_ns, Done done) {
+        if (expected_ns > limit || max_spinners < 1) return false;
+        if (spinning.fetch_add(1, std::memory_order_relaxed) >= max_spinners) {
+            spinning.fetch_sub(1, std::memory_order_relaxed);
+            return false;
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(std::max(2 * expected_ns, min_budget_ns));
+        bool ok = false;
+        for (unsigned k = 1; !(ok = done()); k++) {
+            cpu_relax();
+            if (k % 16 == 0 && std::chrono::steady_clock::now() >= deadline) break;
+        }
+        spinning.fetch_sub(1, std::memory_order_relaxed);
+        return ok;
+    }
+
+private:
+    static constexpr long long min_budget_ns = 1000;
+
+    long long limit;
+    int max_spinners;
+    std::atomic<int> spinning{0};
+};
+
+// Log-linear histogram in the style of HdrHistogram: values below 16 are exact, above that
+// every power of two is split into 16 buckets, so a reported percentile is at most 1/16 above
+// the true value. There is one writer per histogram and counts are plain relaxed stores, so
+// recording costs a few instructions and readers may look at any time.
+class Histogram {
+public:
+    void record(long long v) {
+        ++counts[bucket_of(v)];
+        total = total.load() + v;
+    }
+
+    // Upper bound of the bucket holding the p-th fraction of the samples, 0 if there are none
+    long long percentile(double p) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(p * (double)total)), seen = 0;
+        for (int b = 0; b < buckets; b++) {
+            seen += counts[b].load();
+            if (seen >= rank) return upper_bound(b);
+        }
+        return upper_bound(buckets - 1);
+    }
+
+    long long max() const {
+        for (int b = buckets - 1; b >= 0; b--) {
+            if (counts[b].load() != 0) return upper_bound(b);
+        }
+        return 0;
+    }
+
+    uint64_t count() const {
+        uint64_t samples = 0;
+        for (int b = 0; b < buckets; b++) samples += counts[b].load();
+        return samples;
+    }
+
+    // Samples in buckets that lie wholly at or below v, so up to one bucket width is missed
+    uint64_t count_at_most(long long v) const {
+        uint64_t samples = 0;
+        for (int b = 0; b < buckets && upper_bound(b) <= v; b++) samples += counts[b].load();
+        return samples;
+    }
+
+    long long sum() const { return total.load(); }
+
+    // Adds o's counts to this histogram; the caller must be this histogram's only writer
+    void add(const Histogram& o) {
+        for (int b = 0; b < buckets; b++) counts[b] = counts[b].load() + o.counts[b].load();
+        total = total.load() + o.total.load();
+    }
+
+    // Adds samples values that share v's bucket, leaving sum() alone; same rule as above
+    void add(long long v, uint32_t samples) {
+        int b = bucket_of(v);
+        counts[b] = counts[b].load() + samples;
+    }
+
+    void add_sum(long long v) { total = total.load() + v; }
+
+private:
+    static constexpr int sub_bits = 4;
+    static constexpr int sub = 1 << sub_bits;
+    static constexpr int max_magnitude = 40; // values from 2^40 (about 18 minutes in ns) on share the last bucket
+    static constexpr int buckets = (max_magnitude - sub_bits + 1) * sub;
+
+    Relaxed<uint32_t> counts[buckets];
+    Relaxed<long long> total{0};
+
+    static int bucket_of(long long v) {
+        if (v < sub) return v < 0 ? 0 : (int)v;
+        int e = std::bit_width((uint64_t)v) - 1;
+        if (e >= max_magnitude) return buckets - 1;
+        return (e - sub_bits + 1) * sub + (int)((uint64_t)v >> (e - sub_bits)) - sub;
+    }
+
+    static long long upper_bound(int b) {
+        if (b < sub) return b;
+        int shift = b / sub - 1;
+        return ((long long)(sub + b % sub) << shift) + (1LL << shift) - 1;
+    }
+};
+
+// A philosopher's own wait or hold histogram, which a table keeps two of per seat, so it is small:
+// 8 buckets per power of two (values below 8 exact, percentiles at most 1/8 above the true
+// value), values from 2^36 ns (about a minute) on in the last bucket, and 16-bit counts. A count
+// about to overflow halves every count, and the halves taken off go to a Histogram the table
+// shares, under its lock. The philosopher's percentiles then lean towards its recent meals, while
+// the seats and that spill histogram together still hold every sample.
+class SeatHistogram {
+public:
+    void record(long long v, Histogram& spill, std::mutex& spill_mutex) {
+        int b = bucket_of(v);
+        if (counts[b].load() == UINT16_MAX) halve(spill, spill_mutex);
+        ++counts[b];
+        total = total.load() + v;
+    }
+
+    // Upper bounds of the buckets holding the p-th and q-th fractions (p <= q), in one pass
+    std::pair<long long, long long> percentiles(double p, double q) const {
+        uint64_t samples = 0;
+        for (int b = 0; b < buckets; b++) samples += counts[b].load();
+        if (samples == 0) return {0, 0};
+        uint64_t rank_p = std::max<uint64_t>(1, (uint64_t)std::ceil(p * (double)samples));
+        uint64_t rank_q = std::max<uint64_t>(1, (uint64_t)std::ceil(q * (double)samples)), seen = 0;
+        long long at_p = -1;
+        for (int b = 0; b < buckets; b++) {
+            seen += counts[b].load();
+            if (at_p < 0 && seen >= rank_p) at_p = upper_bound(b);
+            if (seen >= rank_q) return {at_p, upper_bound(b)};
+        }
+        return {at_p < 0 ? upper_bound(buckets - 1) : at_p, upper_bound(buckets - 1)};
+    }
+
+    long long percentile(double p) const { return percentiles(p, p).first; }
+
+    // Adds every sample to h at its bucket's upper bound; the caller must be h's only writer and
+    // hold the spill lock, so that no halving moves samples between the two meanwhile
+    void add_to(Histogram& h) const {
+        for (int b = 0; b < buckets; b++) {
+            if (uint16_t c = counts[b].load()) h.add(upper_bound(b), c);
+        }
+        h.add_sum(total.load());
+    }
+
+private:
+    static constexpr int sub_bits = 3;
+    static constexpr int sub = 1 << sub_bits;
+    static constexpr int max_magnitude = 36;
+    static constexpr int buckets = (max_magnitude - sub_bits + 1) * sub;
+
+    Relaxed<uint16_t> counts[buckets];
+    Relaxed<long long> total{0}; // of every sample, spilled or not
+
+    void halve(Histogram& spill, std::mutex& spill_mutex) {
+        std::lock_guard<std::mutex> lock(spill_mutex);
+        for (int b = 0; b < buckets; b++) {
+            uint16_t c = counts[b].load();
+            spill.add(upper_bound(b), c - c / 2);
+            counts[b] = (uint16_t)(c / 2);
+        }
+    }
+
+    static int bucket_of(long long v) {
+        if (v < sub) return v < 0 ? 0 : (int)v;
+        int e = std::bit_width((uint64_t)v) - 1;
+        if (e >= max_magnitude) return buckets - 1;
+        return (e - sub_bits + 1) * sub + (int)((uint64_t)v >> (e - sub_bits)) - sub;
+    }
+
+    static long long upper_bound(int b) {
+        if (b < sub) return b;
+        int shift = b / sub - 1;
+        return ((long long)(sub + b % sub) << shift) + (1LL << shift) - 1;
+    }
+};
+
+// The fields the renderer shows, published under a seqlock so that snapshot() never takes an
+// arbiter lock. The ring is split into regions, each with its own sequence word, so arbiters
+// with several locks can publish in parallel: whoever writes philosopher or fork i must hold the
+// lock that serialises region_of(i) and bracket the change in a Writer. read() retries a region
+// while a writer is active and gives up after max_read_attempts, so under constant churn a
+// region may come out torn (each field is still a value that was really stored).
+class SnapshotBoard {
+public:
+    // Fields read by arbitration decisions, one record per philosopher i and fork i
+    struct Seat {
+        Relaxed<State> state{THINKING};
+        Relaxed<int> fork_owner{-1};      // -1 free, otherwise philosopher id holding both adjacent forks
+        Relaxed<long long> queued_at{0};  // 0 when not waiting, otherwise the place in line (smaller is served first)
+    };
+
+    // Statistics, kept apart so that counting meals never dirties a line a neighbour decides on
+    struct Tally {
+        Relaxed<int> eat_count{0};
+        Relaxed<int> think_count{0};
+    };
+
+    RecordArray<Seat> seats;
+    RecordArray<Tally> tallies;
+
+    class Writer {
+    public:
+        Writer(SnapshotBoard& b, int r) : board(b), region(r) { board.begin_write(region); }
+        ~Writer() { board.end_write(region); }
+
+    private:
+        SnapshotBoard& board;
+        int region;
+    };
+
+    SnapshotBoard(int num, int num_regions, Layout layout)
+        : seats(num, layout), tallies(num, layout), n(num), regions(num_regions), seq(new Sequence[num_regions]) {}
+
+    int region_begin(int r) const { return (int)((long long)r * n / regions); }
+
+    void begin_write(int r) {
+        std::atomic<unsigned>& s = seq[r].value;
+        s.store(s.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void end_write(int r) {
+        std::atomic<unsigned>& s = seq[r].value;
+        s.store(s.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    void read(TableView& view) const {
+        view.state.resize(n);
+        view.eat_count.resize(n);
+        view.think_count.resize(n);
+        view.fork_owner.resize(n);
+        std::vector<long long>& line = view.line;
+        std::vector<std::pair<long long, int>>& waiting = view.waiting;
+        line.resize(n);
+        waiting.clear();
+        for (int r = 0; r < regions; r++) {
+            int begin = region_begin(r), end = region_begin(r + 1);
+            for (int attempt = 0; attempt < max_read_attempts; attempt++) {
+                unsigned before = seq[r].value.load(std::memory_order_acquire);
+                if (before & 1) {
+                    cpu_relax();
+                    continue;
+                }
+                for (int i = begin; i < end; i++) {
+                    view.state[i] = seats[i].state;
+                    view.fork_owner[i] = seats[i].fork_owner;
+                    line[i] = seats[i].queued_at;
+                    view.eat_count[i] = tallies[i].eat_count;
+                    view.think_count[i] = tallies[i].think_count;
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq[r].value.load(std::memory_order_relaxed) == before) break;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            if (line[i] != 0) waiting.emplace_back(line[i], i);
+        }
+        std::sort(waiting.begin(), waiting.end());
+        view.queue.clear();
+        for (auto& w : waiting) view.queue.push_back(w.second);
+    }
+
+private:
+    static constexpr int max_read_attempts = 64;
+
+    struct alignas(cache_line) Sequence {
+        std::atomic<unsigned> value{0}; // odd while a writer is inside the region
+    };
+
+    int n;
+    int regions;
+    std::unique_ptr<Sequence[]> seq;
+};
+
+// Event trace of the arbiters: every state change, fork grant and wait-queue push/pop goes into
+// a ring owned by the thread that made it, and one flusher thread drains the rings into a binary
+// file. A full ring drops the event rather than stall the table; --trace-convert turns the file
+// into Chrome trace JSON.
+enum class TraceKind : uint16_t { THINKING, HUNGRY, EATING, GRANT, QUEUE_PUSH, QUEUE_POP };
+
+struct TraceEvent {
+    uint64_t ts;     // steady_clock ns
+    int32_t id;      // philosopher
+    uint16_t kind;   // TraceKind
+    uint16_t thread; // ring the event was written to, numbered in order of first use
+};
+
+class Tracer {
+public:
+    static constexpr char magic[8] = {'F', 'I', 'L', 'O', 'T', 'R', 'C', '1'};
+
+    static Tracer* active; // events are recorded only while this is set
+
+    // Events of one call share a timestamp and are published together
+    static void emit(int id, std::initializer_list<TraceKind> kinds) {
+        if (active) active->record(id, kinds);
+    }
+
+    // Trace file: magic, int32 philosopher count, then TraceEvents in flush order
+    static std::unique_ptr<Tracer> open(const std::string& path, int n) {
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) return nullptr;
+        int32_t count = n;
+        std::fwrite(magic, 1, sizeof magic, f);
+        std::fwrite(&count, sizeof count, 1, f);
+        return std::unique_ptr<Tracer>(new Tracer(f));
+    }
+
+    ~Tracer() { close(); }
+
+    // Stops the flusher and writes out whatever is left; callers must have stopped emitting
+    void close() {
+        if (!out) return;
+        {
+            std::lock_guard<std::mutex> lock(flush_mtx);
+            closing = true;
+        }
+        flush_cv.notify_one();
+        flusher.join();
+        drain();
+        std::fclose(out);
+        out = nullptr;
+    }
+
+    uint64_t written() const { return events_written; }
+
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(rings_mtx);
+        uint64_t total = 0;
+        for (auto& r : rings) total += r->dropped.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    static constexpr uint64_t ring_size = 1 << 15; // events per thread, a power of two
+    static constexpr auto flush_interval = std::chrono::milliseconds(2);
+
+    // Single producer (the owning thread), single consumer (the flusher)
+    struct Ring {
+        alignas(cache_line) std::atomic<uint64_t> head{0}; // next event the owner writes
+        std::atomic<uint64_t> dropped{0};
+        alignas(cache_line) std::atomic<uint64_t> tail{0}; // next event the flusher reads
+        uint16_t thread = 0;
+        std::unique_ptr<TraceEvent[]> events{new TraceEvent[ring_size]};
+    };
+
+    FILE* out;
+    std::mutex rings_mtx; // guards rings; taken once per thread on its first event, and by drain()
+    std::vector<std::unique_ptr<Ring>> rings;
+    std::mutex flush_mtx;
+    std::condition_variable flush_cv;
+    bool closing = false;
+    uint64_t events_written = 0;
+    std::thread flusher;
+
+    explicit Tracer(FILE* f) : out(f), flusher(&Tracer::flush_loop, this) {}
+
+    Ring* ring_for_thread() {
+        struct Local {
+            Tracer* owner = nullptr;
+            Ring* ring = nullptr;
+        };
+        thread_local Local local;
+        if (local.owner != this) {
+            std::lock_guard<std::mutex> lock(rings_mtx);
+            local.owner = this;
+            local.ring = nullptr;
+            if (rings.size() <= UINT16_MAX) {
+                rings.emplace_back(new Ring);
+                rings.back()->thread = (uint16_t)(rings.size() - 1);
+                local.ring = rings.back().get();
+            }
+        }
+        return local.ring;
+    }
+
+    void record(int id, std::initializer_list<TraceKind> kinds) {
+        Ring* r = ring_for_thread();
+        if (!r) return;
+        uint64_t h = r->head.load(std::memory_order_relaxed);
+        if (h + kinds.size() - r->tail.load(std::memory_order_acquire) > ring_size) {
+            r->dropped.store(r->dropped.load(std::memory_order_relaxed) + kinds.size(), std::memory_order_relaxed);
+            return;
+        }
+        uint64_t ts = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+        for (TraceKind kind : kinds) r->events[h++ & (ring_size - 1)] = TraceEvent{ts, id, (uint16_t)kind, r->thread};
+        r->head.store(h, std::memory_order_release);
+    }
+
+    void drain() {
+        std::lock_guard<std::mutex> lock(rings_mtx);
+        for (auto& r : rings) {
+            uint64_t t = r->tail.load(std::memory_order_relaxed);
+            uint64_t h = r->head.load(std::memory_order_acquire);
+            while (t != h) {
+                // Up to the end of the buffer, then wrap around
+                uint64_t begin = t & (ring_size - 1);
+                uint64_t count = std::min(h - t, ring_size - begin);
+                std::fwrite(&r->events[begin], sizeof(TraceEvent), count, out);
+                t += count;
+            }
+            events_written += h - r->tail.load(std::memory_order_relaxed);
+            r->tail.store(h, std::memory_order_release);
+        }
+    }
+
+    void flush_loop() {
+        std::unique_lock<std::mutex> lock(flush_mtx);
+        while (!closing) {
+            flush_cv.wait_for(lock, flush_interval, [&]{ return closing; });
+            lock.unlock();
+            drain();
+            lock.lock();
+        }
+    }
+};
+
+Tracer* Tracer::active = nullptr;
+
+// Reads a --trace file and writes it as Chrome trace event JSON (chrome://tracing, Perfetto):
+// one track per philosopher with its THINKING/HUNGRY/EATING spans, and instant events for fork
+// grants and wait-queue pushes/pops
+static bool convert_trace(const std::string& in_path, const std::string& out_path) {
+    FILE* in = std::fopen(in_path.c_str(), "rb");
+    if (!in) {
+        std::cerr << "Cannot open trace " << in_path << "\n";
+        return false;
+    }
+    char header[sizeof Tracer::magic];
+    int32_t n = 0;
+    if (std::fread(header, 1, sizeof header, in) != sizeof header || std::memcmp(header, Tracer::magic, sizeof header) != 0 ||
+        std::fread(&n, sizeof n, 1, in) != 1 || n < 1) {
+        std::cerr << in_path << " is not a trace file\n";
+        std::fclose(in);
+        return false;
+    }
+    std::vector<TraceEvent> events;
+    TraceEvent buffer[4096];
+    size_t got;
+    while ((got = std::fread(buffer, sizeof(TraceEvent), 4096, in)) > 0) events.insert(events.end(), buffer, buffer + got);
+    std::fclose(in);
+    // Rings are flushed one after another, so the file is only ordered per thread
+    std::stable_sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.ts < b.ts; });
+
+    FILE* out = std::fopen(out_path.c_str(), "w");
+    if (!out) {
+        std::cerr << "Cannot write " << out_path << "\n";
+        return false;
+    }
+    uint64_t origin = events.empty() ? 0 : events.front().ts;
+    auto us = [&](uint64_t ts) { return (double)(ts - origin) / 1000.0; };
+    static const char* const state_names[] = {"THINKING", "HUNGRY", "EATING"};
+    static const char* const instant_names[] = {"grant", "queue push", "queue pop"};
+
+    std::fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int i = 0; i < n; i++) {
+        std::fprintf(out, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"philosopher %d\"}},\n", i, i);
+    }
+    // Span of each philosopher's current state, closed by its next transition
+    std::vector<int> state(n, -1);
+    std::vector<uint64_t> since(n, 0);
+    auto close_span = [&](int i, uint64_t until) {
+        if (state[i] < 0) return;
+        std::fprintf(out, "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f},\n",
+                     state_names[state[i]], i, us(since[i]), (double)(until - since[i]) / 1000.0);
+    };
+    for (const TraceEvent& e : events) {
+        if (e.id < 0 || e.id >= n) continue;
+        if (e.kind <= (uint16_t)TraceKind::EATING) {
+            close_span(e.id, e.ts);
+            state[e.id] = e.kind;
+            since[e.id] = e.ts;
+        } else if (e.kind <= (uint16_t)TraceKind::QUEUE_POP) {
+            std::fprintf(out, "{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"args\":{\"thread\":%u}},\n",
+                         instant_names[e.kind - (uint16_t)TraceKind::GRANT], e.id, us(e.ts), (unsigned)e.thread);
+        }
+    }
+    uint64_t last = events.empty() ? 0 : events.back().ts;
+    for (int i = 0; i < n; i++) close_span(i, last);
+    // Metadata record last so that every event above can end with a comma
+    std::fprintf(out, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":0,\"args\":{\"name\":\"%zu events\"}}\n]}\n", events.size());
+    bool ok = std::fclose(out) == 0;
+    if (!ok) std::cerr << "Cannot write " << out_path << "\n";
+    return ok;
+}
+
+// Schedule of a run, written by --record and read back by --replay: every think and eat
+// duration each philosopher drew, and the order in which philosophers were granted. Durations
+// are LEB128 varints of nanoseconds in two streams per philosopher, grants are zigzag varint
+// deltas between consecutive philosopher ids, so a meal costs a few bytes. The header and the
+// stream index have fixed offsets, so a replay decodes the file in place through mmap.
+class Recording {
+public:
+    static constexpr char magic[8] = {'F', 'I', 'L', 'O', 'R', 'E', 'C', '1'};
+
+    enum Stream { THINK, EAT };
+
+    static const Recording* active; // think and eat times are replayed from here while this is set
+
+    static void append(std::vector<uint8_t>& out, uint64_t v) {
+        for (; v >= 0x80; v >>= 7) out.push_back((uint8_t)(v | 0x80));
+        out.push_back((uint8_t)v);
+    }
+
+    // streams[2 * i + s] holds philosopher i's durations of Stream s, as made by append()
+    static bool write(const std::string& path, uint64_t seed, const std::string& arbiter,
+                      const std::vector<const std::vector<uint8_t>*>& streams, const std::vector<int>& grants) {
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f) return false;
+        Header h;
+        std::memcpy(h.magic, magic, sizeof magic);
+        h.n = (int32_t)(streams.size() / 2);
+        h.seed = seed;
+        h.grants = grants.size();
+        std::snprintf(h.arbiter, sizeof h.arbiter, "%s", arbiter.c_str());
+        std::vector<uint64_t> offsets(streams.size() + 1, 0);
+        for (size_t k = 0; k < streams.size(); k++) offsets[k + 1] = offsets[k] + streams[k]->size();
+        std::vector<uint8_t> order;
+        for (size_t g = 0; g < grants.size(); g++) {
+            int64_t delta = grants[g] - (g > 0 ? grants[g - 1] : 0);
+            append(order, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+        }
+        std::fwrite(&h, sizeof h, 1, f);
+        std::fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), f);
+        for (const std::vector<uint8_t>* s : streams) std::fwrite(s->data(), 1, s->size(), f);
+        std::fwrite(order.data(), 1, order.size(), f);
+        return std::fclose(f) == 0;
+    }
+
+    // Maps a file made by write(); on failure returns null and says why in error
+    static std::unique_ptr<Recording> open(const std::string& path, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "Cannot open recording " + path + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        struct stat st;
+        void* base = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header)) base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        error = path + " is not a recording";
+        if (base == MAP_FAILED) return nullptr;
+        std::unique_ptr<Recording> r(new Recording(static_cast<const uint8_t*>(base), st.st_size));
+        const Header& h = *r->header;
+        if (std::memcmp(h.magic, magic, sizeof magic) != 0 || h.n < 1) return nullptr;
+        size_t data = sizeof(Header) + (2 * (size_t)h.n + 1) * sizeof(uint64_t);
+        if ((size_t)st.st_size < data) return nullptr;
+        r->offsets = reinterpret_cast<const uint64_t*>(r->base + sizeof(Header));
+        r->data = r->base + data;
+        // Streams back to back inside the file, then at least a byte for each grant
+        size_t rest = (size_t)st.st_size - data;
+        for (size_t k = 0; k < 2 * (size_t)h.n; k++) {
+            if (r->offsets[k] > r->offsets[k + 1]) return nullptr;
+        }
+        if (r->offsets[0] != 0 || r->offsets[2 * h.n] > rest || h.grants > rest - r->offsets[2 * h.n]) return nullptr;
+        error.clear();
+        return r;
+    }
+
+    ~Recording() { munmap(const_cast<uint8_t*>(base), bytes); }
+
+    Recording(const Recording&) = delete;
+    Recording& operator=(const Recording&) = delete;
+
+    int size() const { return header->n; }
+    uint64_t seed() const { return header->seed; }
+    const char* arbiter() const { return header->arbiter; }
+    uint64_t grants() const { return header->grants; }
+
+    // Next duration of philosopher id's stream, cursor being the byte offset into it; false
+    // once the stream is used up
+    bool next(int id, Stream s, size_t& cursor, long long& ns) const {
+        size_t k = 2 * (size_t)id + s;
+        const uint8_t* p = data + offsets[k] + cursor;
+        const uint8_t* end = data + offsets[k + 1];
+        uint64_t v;
+        if (!decode(p, end, v)) return false;
+        cursor = (size_t)(p - (data + offsets[k]));
+        ns = (long long)v;
+        return true;
+    }
+
+    void grant_order(std::vector<int>& out) const {
+        out.clear();
+        const uint8_t* p = data + offsets[2 * header->n];
+        const uint8_t* end = base + bytes;
+        int id = 0;
+        uint64_t v;
+        while (out.size() < header->grants && decode(p, end, v)) {
+            id += (int)(int64_t)((v >> 1) ^ (~(v & 1) + 1));
+            out.push_back(id);
+        }
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        int32_t n = 0;
+        uint32_t reserved = 0;
+        uint64_t seed = 0;
+        uint64_t grants = 0;
+        char arbiter[32] = {};
+    };
+
+    Recording(const uint8_t* b, size_t size) : base(b), bytes(size), header(reinterpret_cast<const Header*>(b)) {}
+
+    static bool decode(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+        v = 0;
+        for (int shift = 0; p < end && shift < 64; shift += 7) {
+            uint8_t byte = *p++;
+            v |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    const uint8_t* base;
+    size_t bytes;
+    const Header* header;
+    const uint64_t* offsets = nullptr; // 2n + 1 stream boundaries, relative to data
+    const uint8_t* data = nullptr;
+};
+
+const Recording* Recording::active = nullptr;
+
+// Minimal HTTP server for Prometheus scrapes: answers GET /metrics with whatever body() returns,
+// one connection at a time on its own thread. body() runs on that thread, so it must only read
+// state that is safe to read without the arbiter locks.
+class MetricsServer {
+public:
+    // Binds and listens on every interface; nullptr if the port cannot be used
+    static std::unique_ptr<MetricsServer> open(int port) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return nullptr;
+        int on = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons((uint16_t)port);
+        if (::bind(fd, (sockaddr*)&addr, sizeof addr) != 0 || ::listen(fd, 16) != 0) {
+            ::close(fd);
+            return nullptr;
+        }
+        return std::unique_ptr<MetricsServer>(new MetricsServer(fd));
+    }
+
+    ~MetricsServer() { close(); }
+
+    void start(std::function<std::string()> render) {
+        body = std::move(render);
+        server = std::thread(&MetricsServer::serve_loop, this);
+    }
+
+    // Stops answering; returns within one poll interval
+    void close() {
+        closing = true;
+        if (server.joinable()) server.join();
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+private:
+    static constexpr int poll_ms = 100;
+
+    int fd;
+    std::atomic<bool> closing{false};
+    std::function<std::string()> body;
+    std::thread server;
+
+    explicit MetricsServer(int listen_fd) : fd(listen_fd) {}
+
+    void serve_loop() {
+        while (!closing) {
+            pollfd p{fd, POLLIN, 0};
+            if (::poll(&p, 1, poll_ms) <= 0) continue;
+            int client = ::accept(fd, nullptr, nullptr);
+            if (client < 0) continue;
+            answer(client);
+            ::close(client);
+        }
+    }
+
+    void answer(int client) {
+        timeval timeout{1, 0};
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            ssize_t got = ::recv(client, buf, sizeof buf, 0);
+            if (got <= 0) return;
+            request.append(buf, (size_t)got);
+        }
+        std::string status = "200 OK", type = "text/plain; version=0.0.4", content;
+        if (request.compare(0, 13, "GET /metrics ") == 0) {
+            content = body();
+        } else {
+            status = "404 Not Found";
+            type = "text/plain";
+            content = "only GET /metrics is served\n";
+        }
+        std::string reply = "HTTP/1.1 " + status + "\r\nContent-Type: " + type + "\r\nContent-Length: " +
+                            std::to_string(content.size()) + "\r\nConnection: close\r\n\r\n" + content;
+        for (size_t sent = 0; sent < reply.size();) {
+            ssize_t put = ::send(client, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+            if (put <= 0) return;
+            sent += (size_t)put;
+        }
+    }
+};
+
+// Bulk eligibility test for the bitmask scan: bit i of out is set when bit i of hungry is and
+// neither ring neighbour's bit of eating is, 64 philosophers to a word and 256 or 512 at a time
+// where the CPU has AVX2 or AVX-512. hungry and eating are read one word before and after the
+// range, so callers pad them with a zero word on each side. The ring closes between bit 0 and
+// bit n - 1, which the kernel treats as unrelated; the caller fixes those two bits up.
+struct EligibilityKernel {
+    const char* name;
+    void (*run)(const uint64_t* hungry, const uint64_t* eating, uint64_t* out, size_t words);
+
+    static void scalar(const uint64_t* hungry, const uint64_t* eating, uint64_t* out, size_t words) {
+        for (size_t w = 0; w < words; w++) {
+            uint64_t left = (eating[w] << 1) | (eating[w - 1] >> 63);  // bit i: philosopher i - 1 eats
+            uint64_t right = (eating[w] >> 1) | (eating[w + 1] << 63); // bit i: philosopher i + 1 eats
+            out[w] = hungry[w] & ~(left | right);
+        }
+    }
+
+#if defined(__x86_64__)
+    [[gnu::target("avx2")]] static void avx2(const uint64_t* hungry, const uint64_t* eating, uint64_t* out, size_t words) {
+        size_t w = 0;
+        for (; w + 4 <= words; w += 4) {
+            __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(eating + w - 1));
+            __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(eating + w));
+            __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(eating + w + 1));
+            __m256i left = _mm256_or_si256(_mm256_slli_epi64(cur, 1), _mm256_srli_epi64(prev, 63));
+            __m256i right = _mm256_or_si256(_mm256_srli_epi64(cur, 1), _mm256_slli_epi64(next, 63));
+            __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hungry + w));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + w), _mm256_andnot_si256(_mm256_or_si256(left, right), h));
+        }
+        scalar(hungry + w, eating + w, out + w, words - w);
+    }
+
+    // GCC 12 flags the _mm512_undefined_epi32() inside its own AVX-512 intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+    [[gnu::target("avx512f")]] static void avx512(const uint64_t* hungry, const uint64_t* eating, uint64_t* out, size_t words) {
+        size_t w = 0;
+        for (; w + 8 <= words; w += 8) {
+            __m512i prev = _mm512_loadu_si512(eating + w - 1);
+            __m512i cur = _mm512_loadu_si512(eating + w);
+            __m512i next = _mm512_loadu_si512(eating + w + 1);
+            __m512i left = _mm512_or_si512(_mm512_slli_epi64(cur, 1), _mm512_srli_epi64(prev, 63));
+            __m512i right = _mm512_or_si512(_mm512_srli_epi64(cur, 1), _mm512_slli_epi64(next, 63));
+            __m512i h = _mm512_loadu_si512(hungry + w);
+            _mm512_storeu_si512(out + w, _mm512_andnot_si512(_mm512_or_si512(left, right), h));
+        }
+        scalar(hungry + w, eating + w, out + w, words - w);
+    }
+#pragma GCC diagnostic pop
+#endif
+
+    // The widest kernel this CPU runs, picked once
+    static const EligibilityKernel& best() {
+        static const EligibilityKernel kernel = [] {
+#if defined(__x86_64__)
+            if (__builtin_cpu_supports("avx512f")) return EligibilityKernel{"avx-512", avx512};
+            if (__builtin_cpu_supports("avx2")) return EligibilityKernel{"avx2", avx2};
+#endif
+            return EligibilityKernel{"scalar", scalar};
+        }();
+        return kernel;
+    }
+};
+
+// Strategy behind pickup()/putdown(). pickup() blocks until i may eat, or until running is
+// cleared and stop() has been called. snapshot() is called by the renderer and must not take
+// any lock that pickup()/putdown() wait on.
+class Arbiter {
+public:
+    virtual ~Arbiter() = default;
+    virtual const char* name() const = 0;
+    virtual void pickup(int i) = 0;
+    virtual void putdown(int i) = 0;
+    virtual void stop() = 0;
+    virtual void snapshot(TableView& view) = 0;
+
+    // Non-blocking pickup for engines that do not park a thread per philosopher. Once a grant
+    // hook is set, later grants are delivered through it (from the thread whose putdown() made
+    // them, after the arbiter lock is released) instead of waking a pickup() waiter. request(i)
+    // makes i hungry and returns true if it was served on the spot, in which case the hook is not
+    // called.
+    virtual bool supports_requests() const { return false; }
+    virtual bool request(int) { return false; }
+    void set_grant_hook(std::function<void(int)> hook) { on_grant = std::move(hook); }
+
+    // steady_clock ns at which i's last grant was made by another philosopher, 0 if i served
+    // itself; read by i once it runs again to measure grant-to-wakeup latency
+    virtual long long granted_at(int) const { return 0; }
+
+    // Time threads have spent waiting for the arbiter's locks, summed over all of them
+    virtual long long lock_wait_ns() const { return 0; }
+
+    // pickup() calls that could not eat at once: served while spinning, and parked
+    struct WaitCounts {
+        long spin_hits = 0;
+        long parks = 0;
+    };
+    virtual WaitCounts wait_counts() const { return {}; }
+
+    // Makes now_ns() read *virtual_ns instead of steady_clock, for the simulation engine
+    void set_clock(const long long* virtual_ns) { clock = virtual_ns; }
+
+protected:
+    std::function<void(int)> on_grant;
+    const long long* clock = nullptr;
+
+    long long now_ns() const { return clock ? *clock : std::chrono::steady_clock::now().time_since_epoch().count(); }
+
+    // Philosophers granted while the arbiter lock was held, woken once it is released so that
+    // they do not wake up only to block on the lock again. Kept per thread to avoid allocating;
+    // a putdown() frees two forks, so it grants two philosophers at most and the reserve holds.
+    static std::vector<int>& wake_list() {
+        thread_local std::vector<int> list = [] {
+            std::vector<int> reserved;
+            reserved.reserve(16);
+            return reserved;
+        }();
+        return list;
+    }
+
+public:
+    // Allocates the calling thread's wake list now rather than on its first grant
+    static void warm_wake_list() { wake_list(); }
+};
+
+class MonitorArbiter : public Arbiter {
+private:
+    // Private per-philosopher monitor state, next to the condition variable it is woken on
+    struct Waiter {
+        std::condition_variable cv;
+        long long granted_at = 0;
+        int overtaken = 0;     // SCAN: grants made to a neighbour queued behind this waiter
+        QueueLink link;        // place in wait_queue
+        bool passed = false;   // SCAN: waiter was reached by the current scan and could not eat
+        bool waiting = false;  // blocked in cv.wait(), so stop() has to wake it
+        Relaxed<long long> eat_start{0};   // ADAPTIVE: steady_clock ns of the last grant
+        Relaxed<long long> hold_average{0}; // ADAPTIVE: learned grant -> putdown() time
+        Relaxed<long> spin_hits{0};
+        Relaxed<long> parks{0};
+    };
+
+    Options opt;
+    int n;
+    const std::atomic<bool>& running;
+    SnapshotBoard board; // a single region, written under mtx
+    RecordArray<SnapshotBoard::Seat>& seats;
+    RecordArray<SnapshotBoard::Tally>& tallies;
+    RecordArray<Waiter> waiters;
+    long long enqueued = 0; // queue positions handed out so far
+    WaitList<Waiter> wait_queue; // FIFO to avoid starvation; SCAN lets a waiter be overtaken at most bypass_limit times
+    CountingMutex mtx; // monitor lock guarding state/cv
+    int requester = -1; // philosopher inside pickup()/request(), served without a wakeup
+    AdaptiveSpin spinner;
+
+    // BULK: the hungry and eating philosophers as bitmasks, 64 to a word after one word of
+    // padding, the kernel's eligible output, and the waiters it found sorted by place in line
+    const EligibilityKernel& kernel = EligibilityKernel::best();
+    size_t words = 0;
+    std::vector<uint64_t> hungry_bits, eating_bits, eligible;
+    std::vector<std::pair<long long, int>> candidates;
+
+    void mark(std::vector<uint64_t>& bits, int i, bool on) {
+        if (opt.queue != QueuePolicy::BULK) return;
+        uint64_t bit = 1ULL << (i % 64);
+        if (on) bits[1 + i / 64] |= bit;
+        else bits[1 + i / 64] &= ~bit;
+    }
+
+    bool can_eat(int i) const {
+        return seats[i].state == HUNGRY && seats[(i - 1 + n) % n].state != EATING && seats[(i + 1) % n].state != EATING;
+    }
+
+    void grant(int i, std::vector<int>& woken) {
+        // Requires mtx to be held; i must be in wait_queue
+        Waiter& w = waiters[i];
+        wait_queue.remove(i);
+        w.overtaken = 0;
+        seats[i].queued_at = 0;
+        seats[i].state = EATING;
+        mark(hungry_bits, i, false);
+        mark(eating_bits, i, true);
+        seats[i].fork_owner = i;
+        seats[(i + 1) % n].fork_owner = i;
+        ++tallies[i].eat_count;
+        Tracer::emit(i, {TraceKind::QUEUE_POP, TraceKind::GRANT, TraceKind::EATING});
+        if (opt.wait == WaitPolicy::ADAPTIVE) w.eat_start = now_ns();
+        if (i == requester) {
+            w.granted_at = 0;
+        } else {
+            w.granted_at = now_ns();
+            woken.push_back(i);
+        }
+    }
+
+    void deliver(std::vector<int>& woken) {
+        // Called without mtx; the grants are already visible to anyone who takes it
+        for (int id : woken) {
+            if (on_grant) on_grant(id);
+            else waiters[id].cv.notify_one();
+        }
+        woken.clear();
+    }
+
+    void test_front(std::vector<int>& woken) {
+        // Requires mtx to be held; serves requests in FIFO to prevent starvation
+        if (wait_queue.empty()) return;
+        int i = wait_queue.front();
+        if (can_eat(i)) grant(i, woken);
+    }
+
+    bool may_overtake(int neighbour) const {
+        return !waiters[neighbour].passed || waiters[neighbour].overtaken < opt.bypass_limit;
+    }
+
+    void test_queue(std::vector<int>& woken) {
+        // Requires mtx to be held; walks the whole queue and grants every waiter that can eat.
+        // Granting j can only delay its own neighbours, so a waiter ahead of j that is a neighbour
+        // counts the grant as an overtake; once it reaches bypass_limit, neighbours behind it wait.
+        for (int j = wait_queue.front(), next; j >= 0; j = next) {
+            next = wait_queue.next(j);
+            int left = (j - 1 + n) % n, right = (j + 1) % n;
+            if (can_eat(j) && may_overtake(left) && may_overtake(right)) {
+                if (waiters[left].passed) ++waiters[left].overtaken;
+                if (waiters[right].passed) ++waiters[right].overtaken;
+                grant(j, woken);
+            } else {
+                waiters[j].passed = true;
+            }
+        }
+        for (int j = wait_queue.front(); j >= 0; j = wait_queue.next(j)) waiters[j].passed = false;
+    }
+
+    // A neighbour test_queue() would have marked passed by the time it reaches j: one still
+    // hungry and ahead of j in line (a neighbour ahead that was granted is eating, so j cannot eat)
+    bool ahead(int neighbour, int j) const {
+        return seats[neighbour].state == HUNGRY && seats[neighbour].queued_at < seats[j].queued_at;
+    }
+
+    void test_bulk(std::vector<int>& woken) {
+        // Requires mtx to be held; makes test_queue()'s grants in the same order. A waiter that
+        // cannot eat when the scan starts cannot become able to during it, because the scan only
+        // takes forks, so only the waiters the kernel marks eligible are visited, in line order.
+        kernel.run(hungry_bits.data() + 1, eating_bits.data() + 1, eligible.data(), words);
+        int last = n - 1;
+        if (eating_bits[1 + last / 64] >> (last % 64) & 1) eligible[0] &= ~1ULL;
+        if (eating_bits[1] & 1) eligible[last / 64] &= ~(1ULL << (last % 64));
+        candidates.clear();
+        for (size_t w = 0; w < words; w++) {
+            for (uint64_t bits = eligible[w]; bits != 0; bits &= bits - 1) {
+                int j = (int)(w * 64) + std::countr_zero(bits);
+                candidates.emplace_back(seats[j].queued_at, j);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (auto& c : candidates) {
+            int j = c.second;
+            int left = (j - 1 + n) % n, right = (j + 1) % n;
+            bool left_ahead = ahead(left, j), right_ahead = ahead(right, j);
+            if (!can_eat(j) || (left_ahead && waiters[left].overtaken >= opt.bypass_limit) ||
+                (right_ahead && waiters[right].overtaken >= opt.bypass_limit)) continue;
+            if (left_ahead) ++waiters[left].overtaken;
+            if (right_ahead) ++waiters[right].overtaken;
+            grant(j, woken);
+        }
+    }
+
+    void arbitrate(std::vector<int>& woken) {
+        if (opt.queue == QueuePolicy::SCAN) test_queue(woken);
+        else if (opt.queue == QueuePolicy::BULK) test_bulk(woken);
+        else test_front(woken);
+    }
+
+    void hungry(int i, std::vector<int>& woken) {
+        // Requires mtx to be held and the board open for writing
+        if (!wait_queue.contains(i)) {
+            wait_queue.push_back(i);
+            seats[i].queued_at = ++enqueued;
+            Tracer::emit(i, {TraceKind::QUEUE_PUSH, TraceKind::HUNGRY});
+        } else {
+            Tracer::emit(i, {TraceKind::HUNGRY});
+        }
+        seats[i].state = HUNGRY;
+        mark(hungry_bits, i, true);
+        requester = i;
+        arbitrate(woken);
+        requester = -1;
+    }
+
+    friend struct ArbiterProbe; // bench/: times arbitrate() at a given queue depth
+
+public:
+    MonitorArbiter(const Options& o, const std::atomic<bool>& run)
+        : opt(o), n(o.n), running(run), board(o.n, 1, o.layout), seats(board.seats), tallies(board.tallies),
+          waiters(o.n, o.layout), wait_queue(waiters), spinner(o.spin_limit_us * 1000LL) {
+        if (opt.queue == QueuePolicy::BULK) {
+            words = ((size_t)n + 63) / 64;
+            hungry_bits.assign(words + 2, 0);
+            eating_bits.assign(words + 2, 0);
+            eligible.assign(words, 0);
+            candidates.reserve(n);
+        }
+    }
+
+    const char* name() const override {
+        switch (opt.queue) {
+        case QueuePolicy::SCAN: return "monitor/scan";
+        case QueuePolicy::BULK: return "monitor/bulk";
+        case QueuePolicy::FIFO: break;
+        }
+        return "monitor/fifo";
+    }
+
+    const char* kernel_name() const { return kernel.name; }
+
+    void pickup(int i) override {
+        std::vector<int>& woken = wake_list();
+        SiteLock lock(mtx, LockSite::PICKUP);
+        {
+            SnapshotBoard::Writer publish(board, 0);
+            hungry(i, woken);
+        }
+        if (!woken.empty()) {
+            lock.unlock();
+            deliver(woken);
+            lock.lock();
+        }
+        Waiter& w = waiters[i];
+        if (seats[i].state == EATING) return;
+        if (opt.wait == WaitPolicy::ADAPTIVE) {
+            long long expected = std::max(waiters[(i - 1 + n) % n].hold_average.load(), waiters[(i + 1) % n].hold_average.load());
+            lock.unlock();
+            bool hit = spinner.spin(expected, [&]{ return seats[i].state == EATING || !running.load(); });
+            lock.lock(); // also orders the grant's writes before ours
+            if (hit) {
+                ++w.spin_hits;
+                return;
+            }
+        }
+        ++w.parks;
+        w.waiting = true;
+        lock.wait(w.cv, [&]{ return seats[i].state == EATING || !running.load(); });
+        w.waiting = false;
+    }
+
+    bool supports_requests() const override { return true; }
+
+    bool request(int i) override {
+        std::vector<int>& woken = wake_list();
+        bool served;
+        {
+            SiteLock lock(mtx, LockSite::PICKUP);
+            SnapshotBoard::Writer publish(board, 0);
+            hungry(i, woken);
+            served = seats[i].state == EATING;
+        }
+        deliver(woken);
+        return served;
+    }
+
+    void putdown(int i) override {
+        std::vector<int>& woken = wake_list();
+        {
+            SiteLock lock(mtx, LockSite::PUTDOWN);
+            SnapshotBoard::Writer publish(board, 0);
+            if (opt.wait == WaitPolicy::ADAPTIVE) AdaptiveSpin::learn(waiters[i].hold_average, now_ns() - waiters[i].eat_start);
+            seats[i].state = THINKING;
+            mark(eating_bits, i, false);
+            seats[i].fork_owner = -1;
+            seats[(i + 1) % n].fork_owner = -1;
+            ++tallies[i].think_count;
+            Tracer::emit(i, {TraceKind::THINKING});
+            arbitrate(woken);
+        }
+        deliver(woken);
+    }
+
+    void stop() override {
+        // running is already false, so anyone who checks the wait predicate from now on returns;
+        // only the philosophers parked right now need a notify, and it is sent outside the lock
+        std::vector<int> parked;
+        {
+            SiteLock lock(mtx, LockSite::STOP);
+            for (int i = 0; i < n; i++) {
+                if (waiters[i].waiting) parked.push_back(i);
+            }
+        }
+        for (int i : parked) waiters[i].cv.notify_one();
+    }
+
+    long long granted_at(int i) const override { return waiters[i].granted_at; }
+
+    long long lock_wait_ns() const override { return mtx.waited_ns(); }
+
+    WaitCounts wait_counts() const override {
+        WaitCounts c;
+        for (int i = 0; i < n; i++) {
+            c.spin_hits += waiters[i].spin_hits;
+            c.parks += waiters[i].parks;
+        }
+        return c;
+    }
+
+    void snapshot(TableView& view) override {
+        board.read(view);
+    }
+};
+
+// The monitor with FIFO service and parking waiters, specialised for a ring of N philosophers
+// known at compile time (--arbiter fixed). Records are std::arrays, neighbours are constexpr and
+// wrap with a mask when N is a power of two, and the hungry philosophers and taken forks are
+// bitsets, so test_front() reads three bits instead of two neighbours' records. The snapshot
+// board is written alongside, for the renderer only.
+template <int N>
+class FixedMonitorArbiter : public Arbiter {
+private:
+    static constexpr bool power_of_two = (N & (N - 1)) == 0;
+
+    static constexpr int left(int i) {
+        if constexpr (power_of_two) return (i - 1) & (N - 1);
+        else return i == 0 ? N - 1 : i - 1;
+    }
+
+    static constexpr int right(int i) {
+        if constexpr (power_of_two) return (i + 1) & (N - 1);
+        else return i == N - 1 ? 0 : i + 1;
+    }
+
+    static_assert(left(0) == N - 1 && right(N - 1) == 0);
+
+    // One per cache line, as a padded RecordArray would lay it out: neighbours park and grant
+    // each other all the time, and packed they would share lines. --layout packed still packs
+    // the board.
+    struct alignas(cache_line) Waiter {
+        std::condition_variable cv;
+        long long granted_at = 0;
+        QueueLink link;        // place in wait_queue
+        bool waiting = false;  // blocked in cv.wait(), so stop() has to wake it
+        Relaxed<long> parks{0};
+    };
+
+    const std::atomic<bool>& running;
+    SnapshotBoard board; // a single region, written under mtx
+    std::array<Waiter, N> waiters;
+    std::bitset<N> hungry;
+    std::bitset<N> forks; // fork i lies between philosophers i - 1 and i; taken by whoever eats with it
+    long long enqueued = 0;
+    WaitList<Waiter, std::array<Waiter, N>> wait_queue{waiters};
+    CountingMutex mtx;
+    int requester = -1; // philosopher inside pickup()/request(), served without a wakeup
+
+    void grant(int i, std::vector<int>& woken) {
+        // Requires mtx to be held and the board open for writing; i must be in wait_queue
+        wait_queue.remove(i);
+        hungry.reset(i);
+        forks.set(i);
+        forks.set(right(i));
+        board.seats[i].queued_at = 0;
+        board.seats[i].state = EATING;
+        board.seats[i].fork_owner = i;
+        board.seats[right(i)].fork_owner = i;
+        ++board.tallies[i].eat_count;
+        Tracer::emit(i, {TraceKind::QUEUE_POP, TraceKind::GRANT, TraceKind::EATING});
+        if (i == requester) {
+            waiters[i].granted_at = 0;
+        } else {
+            waiters[i].granted_at = now_ns();
+            woken.push_back(i);
+        }
+    }
+
+    void test_front(std::vector<int>& woken) {
+        // Requires mtx to be held; serves requests in FIFO to prevent starvation
+        if (wait_queue.empty()) return;
+        int i = wait_queue.front();
+        if (!forks[i] && !forks[right(i)]) grant(i, woken);
+    }
+
+    void deliver(std::vector<int>& woken) {
+        for (int id : woken) {
+            if (on_grant) on_grant(id);
+            else waiters[id].cv.notify_one();
+        }
+        woken.clear();
+    }
+
+    void become_hungry(int i, std::vector<int>& woken) {
+        // Requires mtx to be held
+        SnapshotBoard::Writer publish(board, 0);
+        wait_queue.push_back(i);
+        hungry.set(i);
+        board.seats[i].queued_at = ++enqueued;
+        board.seats[i].state = HUNGRY;
+        Tracer::emit(i, {TraceKind::QUEUE_PUSH, TraceKind::HUNGRY});
+        requester = i;
+        test_front(woken);
+        requester = -1;
+    }
+
+    friend struct ArbiterProbe; // bench/: times test_front() at a given queue depth
+
+public:
+    FixedMonitorArbiter(const Options& o, const std::atomic<bool>& run) : running(run), board(N, 1, o.layout) {}
+
+    const char* name() const override {
+        static const std::string label = "fixed<" + std::to_string(N) + ">";
+        return label.c_str();
+    }
+
+    void pickup(int i) override {
+        std::vector<int>& woken = wake_list();
+        SiteLock lock(mtx, LockSite::PICKUP);
+        become_hungry(i, woken);
+        if (!woken.empty()) {
+            lock.unlock();
+            deliver(woken);
+            lock.lock();
+        }
+        if (!hungry[i]) return;
+        Waiter& w = waiters[i];
+        ++w.parks;
+        w.waiting = true;
+        lock.wait(w.cv, [&]{ return !hungry[i] || !running.load(); });
+        w.waiting = false;
+    }
+
+    bool supports_requests() const override { return true; }
+
+    bool request(int i) override {
+        std::vector<int>& woken = wake_list();
+        bool served;
+        {
+            SiteLock lock(mtx, LockSite::PICKUP);
+            become_hungry(i, woken);
+            served = !hungry[i];
+        }
+        deliver(woken);
+        return served;
+    }
+
+    void putdown(int i) override {
+        std::vector<int>& woken = wake_list();
+        {
+            SiteLock lock(mtx, LockSite::PUTDOWN);
+            SnapshotBoard::Writer publish(board, 0);
+            forks.reset(i);
+            forks.reset(right(i));
+            board.seats[i].state = THINKING;
+            board.seats[i].fork_owner = -1;
+            board.seats[right(i)].fork_owner = -1;
+            ++board.tallies[i].think_count;
+            Tracer::emit(i, {TraceKind::THINKING});
+            test_front(woken);
+        }
+        deliver(woken);
+    }
+
+    void stop() override {
+        // As in the monitor: notify the philosophers parked right now, outside the lock
+        std::vector<int> parked;
+        {
+            SiteLock lock(mtx, LockSite::STOP);
+            for (int i = 0; i < N; i++) {
+                if (waiters[i].waiting) parked.push_back(i);
+            }
+        }
+        for (int i : parked) waiters[i].cv.notify_one();
+    }
+
+    long long granted_at(int i) const override { return waiters[i].granted_at; }
+
+    long long lock_wait_ns() const override { return mtx.waited_ns(); }
+
+    WaitCounts wait_counts() const override {
+        WaitCounts c;
+        for (const Waiter& w : waiters) c.parks += w.parks;
+        return c;
+    }
+
+    void snapshot(TableView& view) override {
+        board.read(view);
+    }
+};
+
+// Splits the ring into contiguous segments with one lock each. A decision about philosopher j
+// reads j-2..j+2, so pickup(i) locks the segments of i-2..i+2 and putdown(i), which tests both
+// neighbours, those of i-3..i+3. Segments hold at least six philosophers, so that is never more
+// than two adjacent segments; they are locked in index order. Philosophers away from segment
+// boundaries only ever take their own segment's lock.
+//
+// Instead of one global FIFO queue, a hungry philosopher carries a ticket taken when it became
+// hungry and is not served while a neighbour with an older ticket is still hungry, except that
+// an older neighbour that could not eat anyway (its other neighbour is eating) may be overtaken
+// up to bypass_limit times, as in the monitor's SCAN policy. The oldest waiter on the table can
+// therefore only be delayed by a bounded number of grants, and each neighbour's putdown()
+// retests it, which gives the same starvation-freedom as the queue without a shared counter or
+// list that every segment would contend on. Each segment is one region of the
+// snapshot board, so segments publish to the renderer independently.
+class ShardedArbiter : public Arbiter {
+private:
+    struct alignas(cache_line) Segment {
+        CountingMutex mtx;
+    };
+
+    struct Waiter {
+        std::condition_variable cv; // waits on the lock of the philosopher's own segment
+        long long granted_at = 0;
+        int overtaken = 0;          // grants made to a younger neighbour while this philosopher waited
+        bool waiting = false;       // blocked in cv.wait(), so stop() has to wake it
+        Relaxed<long long> eat_start{0};    // ADAPTIVE: steady_clock ns of the last grant
+        Relaxed<long long> hold_average{0}; // ADAPTIVE: learned grant -> putdown() time
+        Relaxed<long> spin_hits{0};
+        Relaxed<long> parks{0};
+    };
+
+    int n;
+    int shards;
+    const std::atomic<bool>& running;
+    std::vector<int> segment_of;
+    std::unique_ptr<Segment[]> segments;
+    SnapshotBoard board; // region s is written under segments[s].mtx; seats[i].queued_at is i's ticket,
+                         // the steady_clock ns at which it became hungry, 0 once served
+    RecordArray<SnapshotBoard::Seat>& seats;
+    RecordArray<SnapshotBoard::Tally>& tallies;
+    RecordArray<Waiter> waiters;
+    int bypass_limit;
+    bool adaptive;
+    AdaptiveSpin spinner;
+
+    // Locks every segment that covers i-radius..i+radius, in ascending segment order, and opens
+    // their regions of the snapshot board for writing
+    class SegmentLock {
+    public:
+        SegmentLock(ShardedArbiter& t, int i, int radius, LockSite site) : table(t) {
+            for (int d = -radius; d <= radius; d++) {
+                int s = t.segment_of[((i + d) % t.n + t.n) % t.n];
+                if (std::find(held, held + count, s) == held + count) held[count++] = s;
+            }
+            if (count == 2 && held[1] < held[0]) std::swap(held[0], held[1]);
+            for (int k = 0; k < count; k++) {
+                table.segments[held[k]].mtx.lock(site);
+                table.board.begin_write(held[k]);
+            }
+        }
+        ~SegmentLock() {
+            for (int k = count - 1; k >= 0; k--) {
+                table.board.end_write(held[k]);
+                table.segments[held[k]].mtx.unlock();
+            }
+        }
+
+    private:
+        ShardedArbiter& table;
+        int held[2];
+        int count = 0;
+    };
+
+    bool older(int a, int b) const {
+        long long ta = seats[a].queued_at, tb = seats[b].queued_at;
+        return ta < tb || (ta == tb && a < b);
+    }
+
+    bool blocks(int neighbour, int beyond, int j) const {
+        // beyond is the neighbour's other neighbour
+        if (seats[neighbour].state == EATING) return true;
+        if (seats[neighbour].state != HUNGRY || !older(neighbour, j)) return false;
+        return seats[beyond].state != EATING || waiters[neighbour].overtaken >= bypass_limit;
+    }
+
+    void count_overtake(int neighbour, int j) {
+        if (seats[neighbour].state == HUNGRY && older(neighbour, j)) ++waiters[neighbour].overtaken;
+    }
+
+    bool test(int j) {
+        // Requires the segments of j-2..j+2 to be locked
+        int left = (j - 1 + n) % n, right = (j + 1) % n;
+        if (seats[j].state == HUNGRY && !blocks(left, (j - 2 + n) % n, j) && !blocks(right, (j + 2) % n, j)) {
+            count_overtake(left, j);
+            count_overtake(right, j);
+            waiters[j].overtaken = 0;
+            seats[j].state = EATING;
+            seats[j].queued_at = 0;
+            seats[j].fork_owner = j;
+            seats[right].fork_owner = j;
+            ++tallies[j].eat_count;
+            Tracer::emit(j, {TraceKind::QUEUE_POP, TraceKind::GRANT, TraceKind::EATING});
+            if (adaptive) waiters[j].eat_start = now_ns();
+            return true;
+        }
+        return false;
+    }
+
+    void serve(int j, std::vector<int>& woken) {
+        // Tests a neighbour after a putdown(); it is woken once the segment locks are released
+        if (!test(j)) return;
+        waiters[j].granted_at = now_ns();
+        woken.push_back(j);
+    }
+
+    void hungry(int i) {
+        // Requires the segments of i-2..i+2 to be locked
+        seats[i].queued_at = now_ns();
+        seats[i].state = HUNGRY;
+        Tracer::emit(i, {TraceKind::QUEUE_PUSH, TraceKind::HUNGRY});
+    }
+
+public:
+    ShardedArbiter(const Options& o, const std::atomic<bool>& run)
+        : n(o.n), shards(shard_count(o)), running(run), segment_of(o.n),
+          segments(new Segment[shards]), board(o.n, shards, o.layout), seats(board.seats), tallies(board.tallies),
+          waiters(o.n, o.layout), bypass_limit(o.bypass_limit), adaptive(o.wait == WaitPolicy::ADAPTIVE),
+          spinner(o.spin_limit_us * 1000LL) {
+        for (int s = 0; s < shards; s++) {
+            for (int i = board.region_begin(s); i < board.region_begin(s + 1); i++) {
+                segment_of[i] = s;
+            }
+        }
+    }
+
+    static int shard_count(const Options& o) { return std::max(1, std::min(o.shards, o.n / 6)); }
+
+    const char* name() const override { return "sharded"; }
+
+    void pickup(int i) override {
+        {
+            SegmentLock lock(*this, i, 2, LockSite::PICKUP);
+            hungry(i);
+            if (test(i)) {
+                waiters[i].granted_at = 0;
+                return;
+            }
+        }
+        Waiter& w = waiters[i];
+        if (adaptive) {
+            long long expected = std::max(waiters[(i - 1 + n) % n].hold_average.load(), waiters[(i + 1) % n].hold_average.load());
+            if (spinner.spin(expected, [&]{ return seats[i].state == EATING || !running.load(); })) {
+                // Taking the lock orders the grant's writes before ours
+                SiteLock lock(segments[segment_of[i]].mtx, LockSite::PICKUP);
+                ++w.spin_hits;
+                return;
+            }
+        }
+        SiteLock lock(segments[segment_of[i]].mtx, LockSite::PICKUP);
+        ++w.parks;
+        w.waiting = true;
+        lock.wait(w.cv, [&]{ return seats[i].state == EATING || !running.load(); });
+        w.waiting = false;
+    }
+
+    bool supports_requests() const override { return true; }
+
+    bool request(int i) override {
+        SegmentLock lock(*this, i, 2, LockSite::PICKUP);
+        hungry(i);
+        if (!test(i)) return false;
+        waiters[i].granted_at = 0;
+        return true;
+    }
+
+    void putdown(int i) override {
+        std::vector<int>& woken = wake_list();
+        {
+            SegmentLock lock(*this, i, 3, LockSite::PUTDOWN);
+            if (adaptive) AdaptiveSpin::learn(waiters[i].hold_average, now_ns() - waiters[i].eat_start);
+            seats[i].state = THINKING;
+            seats[i].fork_owner = -1;
+            seats[(i + 1) % n].fork_owner = -1;
+            ++tallies[i].think_count;
+            Tracer::emit(i, {TraceKind::THINKING});
+            serve((i - 1 + n) % n, woken);
+            serve((i + 1) % n, woken);
+        }
+        for (int id : woken) {
+            if (on_grant) on_grant(id);
+            else waiters[id].cv.notify_one();
+        }
+        woken.clear();
+    }
+
+    void stop() override {
+        // As in the monitor: collect the parked philosophers segment by segment, notify unlocked
+        std::vector<int> parked;
+        for (int s = 0; s < shards; s++) {
+            SiteLock lock(segments[s].mtx, LockSite::STOP);
+            for (int i = board.region_begin(s); i < board.region_begin(s + 1); i++) {
+                if (waiters[i].waiting) parked.push_back(i);
+            }
+        }
+        for (int i : parked) waiters[i].cv.notify_one();
+    }
+
+    long long granted_at(int i) const override { return waiters[i].granted_at; }
+
+    long long lock_wait_ns() const override {
+        long long total = 0;
+        for (int s = 0; s < shards; s++) total += segments[s].mtx.waited_ns();
+        return total;
+    }
+
+    WaitCounts wait_counts() const override {
+        WaitCounts c;
+        for (int i = 0; i < n; i++) {
+            c.spin_hits += waiters[i].spin_hits;
+            c.parks += waiters[i].parks;
+        }
+        return c;
+    }
+
+    void snapshot(TableView& view) override {
+        board.read(view);
+    }
+};
+
+// Lock-free fork acquisition: fork_owner words are claimed with CAS, the lower-numbered fork first,
+// and the first fork is released again if the second is taken (no hold-and-wait, so no deadlock).
+// A philosopher that keeps failing parks on its own wake word after opt.spin attempts; releasing a
+// fork bumps the word of the other philosopher sharing it. There is no queue, so unlike the
+// monitor this backend gives no starvation bound; it trades fairness for wakeup latency.
+class AtomicArbiter : public Arbiter {
+private:
+    // Philosopher i's words and fork i; neighbours CAS the fork and bump the wake word
+    struct Slot {
+        std::atomic<int> fork_owner{-1};  // -1 free, otherwise the claiming philosopher
+        std::atomic<unsigned> wake{0};    // bumped on every release a waiter may care about
+        std::atomic<bool> parked{false};  // waiter is (about to be) blocked in wake.wait()
+        std::atomic<State> state{THINKING};
+        std::atomic<long long> woken_at{0}; // last notify sent to a parked waiter
+    };
+
+    struct Tally {
+        std::atomic<int> eat_count{0};
+        std::atomic<int> think_count{0};
+        std::atomic<long> spin_hits{0};
+        std::atomic<long> parks{0};
+    };
+
+    int n;
+    int spin;
+    const std::atomic<bool>& running;
+    RecordArray<Slot> slots;
+    RecordArray<Tally> tallies;
+
+    void wake_up(int j) {
+        slots[j].wake.fetch_add(1);
+        if (slots[j].parked.load()) {
+            slots[j].woken_at.store(now_ns(), std::memory_order_relaxed);
+            slots[j].wake.notify_one();
+        }
+    }
+
+    void release(int fork, int i) {
+        slots[fork].fork_owner.store(-1);
+        // Fork f lies between philosophers f-1 and f; wake whichever of them is not i
+        wake_up(fork == i ? (fork - 1 + n) % n : fork);
+    }
+
+    bool try_claim(int i) {
+        int first = i, second = (i + 1) % n;
+        if (second < first) std::swap(first, second);
+        int expected = -1;
+        if (slots[first].fork_owner.load(std::memory_order_relaxed) != -1 ||
+            !slots[first].fork_owner.compare_exchange_strong(expected, i)) return false;
+        expected = -1;
+        if (!slots[second].fork_owner.compare_exchange_strong(expected, i)) {
+            release(first, i); // back off
+            return false;
+        }
+        return true;
+    }
+
+public:
+    AtomicArbiter(const Options& o, const std::atomic<bool>& run)
+        : n(o.n), spin(o.spin), running(run), slots(o.n, o.layout), tallies(o.n, o.layout) {}
+
+    const char* name() const override { return "atomic"; }
+
+    void pickup(int i) override {
+        Slot& me = slots[i];
+        me.state.store(HUNGRY, std::memory_order_relaxed);
+        me.woken_at.store(0, std::memory_order_relaxed);
+        Tracer::emit(i, {TraceKind::HUNGRY});
+        bool claimed = false;
+        int k = 0;
+        for (; k < spin && !claimed; k++) {
+            claimed = try_claim(i);
+            if (!claimed) cpu_relax();
+        }
+        if (!claimed) tallies[i].parks.fetch_add(1, std::memory_order_relaxed);
+        else if (k > 1) tallies[i].spin_hits.fetch_add(1, std::memory_order_relaxed);
+        while (!claimed && running.load()) {
+            unsigned seen = me.wake.load();
+            if ((claimed = try_claim(i))) break;
+            me.parked.store(true);
+            // Recheck after announcing the park: a release or stop() that missed the flag is visible here
+            if (!running.load()) {
+                me.parked.store(false);
+                break;
+            }
+            claimed = try_claim(i);
+            if (!claimed) me.wake.wait(seen);
+            me.parked.store(false);
+        }
+        if (!claimed) return; // stopped while waiting
+        me.state.store(EATING, std::memory_order_relaxed);
+        tallies[i].eat_count.fetch_add(1, std::memory_order_relaxed);
+        Tracer::emit(i, {TraceKind::GRANT, TraceKind::EATING});
+    }
+
+    void putdown(int i) override {
+        slots[i].state.store(THINKING, std::memory_order_relaxed);
+        tallies[i].think_count.fetch_add(1, std::memory_order_relaxed);
+        Tracer::emit(i, {TraceKind::THINKING});
+        release(i, i);
+        release((i + 1) % n, i);
+    }
+
+    void stop() override {
+        // Bump every word so that a waiter about to park sees a changed value, but only make the
+        // notify call for philosophers that announced they are parked
+        for (int i = 0; i < n; i++) {
+            slots[i].wake.fetch_add(1);
+            if (slots[i].parked.load()) slots[i].wake.notify_one();
+        }
+    }
+
+    long long granted_at(int i) const override { return slots[i].woken_at.load(std::memory_order_relaxed); }
+
+    WaitCounts wait_counts() const override {
+        WaitCounts c;
+        for (int i = 0; i < n; i++) {
+            c.spin_hits += tallies[i].spin_hits.load(std::memory_order_relaxed);
+            c.parks += tallies[i].parks.load(std::memory_order_relaxed);
+        }
+        return c;
+    }
+
+    void snapshot(TableView& view) override {
+        // Word-by-word copy, not a consistent cut; good enough for the display
+        view.state.resize(n);
+        view.eat_count.resize(n);
+        view.think_count.resize(n);
+        view.fork_owner.resize(n);
+        view.queue.clear();
+        for (int i = 0; i < n; i++) {
+            view.state[i] = slots[i].state.load(std::memory_order_relaxed);
+            view.fork_owner[i] = slots[i].fork_owner.load(std::memory_order_relaxed);
+            view.eat_count[i] = tallies[i].eat_count.load(std::memory_order_relaxed);
+            view.think_count[i] = tallies[i].think_count.load(std::memory_order_relaxed);
+            if (view.state[i] == HUNGRY) view.queue.push_back(i);
+        }
+    }
+};
+
+// Textbook solutions built from one lock per fork. The locks are binary semaphores rather than
+// mutexes so that they have no owning thread, and every wait polls running every stop_poll, so
+// stop() needs no wakeup. pickup() can only block, so these need one thread per philosopher.
+// Semaphores do not queue fairly, so neither gives a starvation bound: with no think time a
+// philosopher can keep taking back a fork its neighbour is waiting for.
+class ForkLockArbiter : public Arbiter {
+protected:
+    struct Fork {
+        std::binary_semaphore lock{1};
+        std::atomic<long long> waited{0}; // ns spent blocked on this fork
+    };
+
+    static constexpr auto stop_poll = std::chrono::milliseconds(10);
+
+    int n;
+    const std::atomic<bool>& running;
+    RecordArray<Fork> forks;
+    RecordArray<SnapshotBoard::Seat> seats;   // each field written by the philosopher or fork lock holder it belongs to
+    RecordArray<SnapshotBoard::Tally> tallies;
+
+    // Blocks until s is taken, false if the table stopped first; time spent blocked goes to waited
+    template <class Semaphore>
+    bool take(Semaphore& s, std::atomic<long long>& waited) {
+        if (s.try_acquire()) return true;
+        auto start = std::chrono::steady_clock::now();
+        bool taken = false;
+        while (!(taken = s.try_acquire_for(stop_poll)) && running.load()) {}
+        waited.fetch_add((std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        return taken;
+    }
+
+    // Takes fork first, then fork second; both or neither
+    bool take_forks(int first, int second) {
+        if (!take(forks[first].lock, forks[first].waited)) return false;
+        if (take(forks[second].lock, forks[second].waited)) return true;
+        forks[first].lock.release();
+        return false;
+    }
+
+    // Takes both forks of i, false if the table stopped first
+    virtual bool acquire(int i) = 0;
+    virtual void release_seat(int) {}
+
+public:
+    ForkLockArbiter(const Options& o, const std::atomic<bool>& run)
+        : n(o.n), running(run), forks(o.n, o.layout), seats(o.n, o.layout), tallies(o.n, o.layout) {}
+
+    void pickup(int i) override {
+        seats[i].queued_at = now_ns();
+        seats[i].state = HUNGRY;
+        Tracer::emit(i, {TraceKind::HUNGRY});
+        if (!acquire(i)) return;
+        seats[i].queued_at = 0;
+        seats[i].state = EATING;
+        seats[i].fork_owner = i;
+        seats[(i + 1) % n].fork_owner = i;
+        ++tallies[i].eat_count;
+        Tracer::emit(i, {TraceKind::GRANT, TraceKind::EATING});
+    }
+
+    void putdown(int i) override {
+        seats[i].state = THINKING;
+        seats[i].fork_owner = -1;
+        seats[(i + 1) % n].fork_owner = -1;
+        ++tallies[i].think_count;
+        Tracer::emit(i, {TraceKind::THINKING});
+        forks[i].lock.release();
+        forks[(i + 1) % n].lock.release();
+        release_seat(i);
+    }
+
+    void stop() override {}
+
+    long long lock_wait_ns() const override {
+        long long total = 0;
+        for (int f = 0; f < n; f++) total += forks[f].waited.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    void snapshot(TableView& view) override {
+        // Word-by-word copy, not a consistent cut; waiters are listed by how long they have waited
+        view.state.resize(n);
+        view.eat_count.resize(n);
+        view.think_count.resize(n);
+        view.fork_owner.resize(n);
+        std::vector<std::pair<long long, int>>& waiting = view.waiting;
+        waiting.clear();
+        for (int i = 0; i < n; i++) {
+            view.state[i] = seats[i].state;
+            view.fork_owner[i] = seats[i].fork_owner;
+            view.eat_count[i] = tallies[i].eat_count;
+            view.think_count[i] = tallies[i].think_count;
+            long long since = seats[i].queued_at;
+            if (since != 0) waiting.emplace_back(since, i);
+        }
+        std::sort(waiting.begin(), waiting.end());
+        view.queue.clear();
+        for (auto& w : waiting) view.queue.push_back(w.second);
+    }
+};
+
+// Resource hierarchy: every philosopher takes the lower-numbered of its forks first, so the
+// philosopher next to the wrap-around reaches in the opposite order and no cycle can form
+class HierarchyArbiter : public ForkLockArbiter {
+protected:
+    bool acquire(int i) override {
+        int first = i, second = (i + 1) % n;
+        if (second < first) std::swap(first, second);
+        return take_forks(first, second);
+    }
+
+public:
+    using ForkLockArbiter::ForkLockArbiter;
+
+    const char* name() const override { return "hierarchy"; }
+};
+
+// The waiter: at most n-1 philosophers may reach for forks at once, which breaks the cycle, so
+// forks are taken in the natural left-then-right order
+class WaiterArbiter : public ForkLockArbiter {
+private:
+    std::counting_semaphore<> tokens;
+    std::atomic<long long> token_waited{0};
+
+protected:
+    bool acquire(int i) override {
+        if (!take(tokens, token_waited)) return false;
+        if (take_forks(i, (i + 1) % n)) return true;
+        tokens.release();
+        return false;
+    }
+
+    void release_seat(int) override { tokens.release(); }
+
+public:
+    WaiterArbiter(const Options& o, const std::atomic<bool>& run) : ForkLockArbiter(o, run), tokens(o.n - 1) {}
+
+    const char* name() const override { return "waiter"; }
+
+    long long lock_wait_ns() const override {
+        return ForkLockArbiter::lock_wait_ns() + token_waited.load(std::memory_order_relaxed);
+    }
+};
+
+// Chandy-Misra: every fork always belongs to one of its two philosophers and is dirty once eaten
+// with. A hungry philosopher asks for the forks it lacks; the holder hands a dirty fork over
+// (cleaning it) unless it is eating, and keeps a clean one, deferring the request until its
+// putdown(). A hungry holder that gives up a dirty fork asks for it back at once. Forks start
+// dirty with the lower-numbered philosopher, so the precedence graph is acyclic and nobody
+// starves. Messages are modelled as the receiver's handler running on the sender's thread under
+// the fork's lock; a philosopher is granted by whoever completes its pair of forks, under both.
+class ChandyMisraArbiter : public Arbiter {
+private:
+    struct Fork {
+        std::mutex mtx;
+        Relaxed<int> holder{-1};
+        bool dirty = true;
+        bool requested = false; // the other philosopher asked for it and has not got it yet
+    };
+
+    struct Philosopher {
+        std::atomic<State> state{THINKING};
+        std::atomic<unsigned> wake{0}; // bumped when a neighbour grants this philosopher
+        Relaxed<long long> granted_at{0};
+        Relaxed<long long> hungry_since{0};
+    };
+
+    struct Tally {
+        std::atomic<int> eat_count{0};
+        std::atomic<int> think_count{0};
+    };
+
+    int n;
+    const std::atomic<bool>& running;
+    RecordArray<Fork> forks;              // philosopher i eats with forks i and i+1
+    RecordArray<Philosopher> philosophers;
+    RecordArray<Tally> tallies;
+
+    // Locks both forks of i in ascending index order
+    class ForkPair {
+    public:
+        ForkPair(ChandyMisraArbiter& t, int i) : a(&t.forks[i].mtx), b(&t.forks[(i + 1) % t.n].mtx) {
+            if ((i + 1) % t.n < i) std::swap(a, b);
+            a->lock();
+            b->lock();
+        }
+        ~ForkPair() {
+            b->unlock();
+            a->unlock();
+        }
+
+    private:
+        std::mutex* a;
+        std::mutex* b;
+    };
+
+    void ask(int i, int f) {
+        // Requires fork f to be locked: i's request for f, handled as its holder would
+        Fork& fork = forks[f];
+        int holder = fork.holder;
+        if (holder == i) return;
+        State held_by = philosophers[holder].state.load();
+        if (fork.dirty && held_by != EATING) {
+            fork.holder = i;
+            fork.dirty = false;
+            fork.requested = held_by == HUNGRY;
+        } else {
+            fork.requested = true;
+        }
+    }
+
+    bool try_grant(int i) {
+        // Requires both forks of i to be locked
+        int right = (i + 1) % n;
+        Philosopher& p = philosophers[i];
+        if (p.state.load() != HUNGRY || forks[i].holder != i || forks[right].holder != i) return false;
+        forks[i].dirty = forks[right].dirty = true;
+        p.hungry_since = 0;
+        p.state.store(EATING);
+        tallies[i].eat_count.fetch_add(1, std::memory_order_relaxed);
+        Tracer::emit(i, {TraceKind::GRANT, TraceKind::EATING});
+        return true;
+    }
+
+    bool hungry(int i) {
+        // Asks for the missing forks; true if i may eat right away
+        Philosopher& p = philosophers[i];
+        p.hungry_since = now_ns();
+        p.state.store(HUNGRY);
+        Tracer::emit(i, {TraceKind::HUNGRY});
+        ForkPair lock(*this, i);
+        ask(i, i);
+        ask(i, (i + 1) % n);
+        if (!try_grant(i)) return false;
+        p.granted_at = 0;
+        return true;
+    }
+
+    void hand_over(int f, int i, int to, std::vector<int>& woken) {
+        // Passes fork f from i to its other philosopher if that one asked for it
+        ForkPair lock(*this, to);
+        Fork& fork = forks[f];
+        if (!fork.requested || fork.holder != i) return;
+        fork.holder = to;
+        fork.dirty = false;
+        fork.requested = false;
+        if (!try_grant(to)) return;
+        philosophers[to].granted_at = now_ns();
+        woken.push_back(to);
+    }
+
+public:
+    ChandyMisraArbiter(const Options& o, const std::atomic<bool>& run)
+        : n(o.n), running(run), forks(o.n, o.layout), philosophers(o.n, o.layout), tallies(o.n, o.layout) {
+        // Fork f lies between philosophers f-1 and f
+        for (int f = 0; f < n; f++) forks[f].holder = f == 0 ? 0 : f - 1;
+    }
+
+    const char* name() const override { return "chandy-misra"; }
+
+    void pickup(int i) override {
+        Philosopher& p = philosophers[i];
+        unsigned seen = p.wake.load();
+        if (hungry(i)) return;
+        while (p.state.load() != EATING && running.load()) {
+            p.wake.wait(seen);
+            seen = p.wake.load();
+        }
+    }
+
+    bool supports_requests() const override { return true; }
+
+    bool request(int i) override { return hungry(i); }
+
+    void putdown(int i) override {
+        std::vector<int>& woken = wake_list();
+        philosophers[i].state.store(THINKING);
+        tallies[i].think_count.fetch_add(1, std::memory_order_relaxed);
+        Tracer::emit(i, {TraceKind::THINKING});
+        hand_over(i, i, (i - 1 + n) % n, woken);
+        hand_over((i + 1) % n, i, (i + 1) % n, woken);
+        for (int id : woken) {
+            if (on_grant) {
+                on_grant(id);
+            } else {
+                philosophers[id].wake.fetch_add(1);
+                philosophers[id].wake.notify_one();
+            }
+        }
+        woken.clear();
+    }
+
+    void stop() override {
+        for (int i = 0; i < n; i++) {
+            philosophers[i].wake.fetch_add(1);
+            philosophers[i].wake.notify_one();
+        }
+    }
+
+    long long granted_at(int i) const override { return philosophers[i].granted_at; }
+
+    void snapshot(TableView& view) override {
+        // Word-by-word copy; a fork counts as held while its holder is eating
+        view.state.resize(n);
+        view.eat_count.resize(n);
+        view.think_count.resize(n);
+        view.fork_owner.resize(n);
+        std::vector<std::pair<long long, int>>& waiting = view.waiting;
+        waiting.clear();
+        for (int i = 0; i < n; i++) {
+            view.state[i] = philosophers[i].state.load(std::memory_order_relaxed);
+            view.eat_count[i] = tallies[i].eat_count.load(std::memory_order_relaxed);
+            view.think_count[i] = tallies[i].think_count.load(std::memory_order_relaxed);
+            long long since = philosophers[i].hungry_since;
+            if (view.state[i] == HUNGRY && since != 0) waiting.emplace_back(since, i);
+        }
+        for (int f = 0; f < n; f++) {
+            int holder = forks[f].holder;
+            view.fork_owner[f] = view.state[holder] == EATING ? holder : -1;
+        }
+        std::sort(waiting.begin(), waiting.end());
+        view.queue.clear();
+        for (auto& w : waiting) view.queue.push_back(w.second);
+    }
+};
+
+// Table state shared by the processes of a partitioned run (--partitions P). The ring is cut
+// into P contiguous slices; the parent maps this region before forking and every child runs one
+// slice. Only the boundary forks, the first fork of every slice, are arbitrated here; everything
+// else lives in the child's own arbiter. Children copy their seats and finally their statistics
+// into the region, which the parent aggregates. Every field is a lock-free atomic, so it works
+// the same from any process that maps it.
+class SharedTable {
+public:
+    // Process-shared FIFO ticket lock: takers are served in the order they drew a ticket, so the
+    // two partitions sharing a boundary fork take turns instead of one barging past the other
+    struct alignas(cache_line) Fork {
+        std::atomic<uint32_t> next{0};     // ticket the next taker draws
+        std::atomic<uint32_t> serving{0};  // ticket that holds the fork; waiters sleep on it
+        std::atomic<int> owner{-1};        // global id of the philosopher holding it
+        std::atomic<long long> waited{0};  // ns spent blocked on it, from either side
+    };
+
+    // One philosopher as last published by its partition, in global ids
+    struct Seat {
+        Relaxed<State> state{THINKING};
+        Relaxed<int> fork_owner{-1};   // interior forks only; boundary forks have Fork::owner
+        Relaxed<int> eat_count{0};
+        Relaxed<int> think_count{0};
+        Relaxed<int> queue_rank{0};    // place in its partition's wait queue, 0 when not queued
+        Relaxed<long long> wait_p50{0}, wait_p99{0}, hold_p50{0}, hold_p99{0};
+    };
+
+    // Written once by a partition as it finishes
+    struct Result {
+        Histogram wait, hold;
+        Relaxed<long> meals{0};
+        Relaxed<double> elapsed_s{0};
+        Relaxed<long long> wait_max_ns{0};
+        Relaxed<long long> lock_wait_ns{0};
+        Relaxed<long> spin_hits{0};
+        Relaxed<long> parks{0};
+        std::atomic<bool> done{false};
+    };
+
+    static std::unique_ptr<SharedTable> open(int n, int partitions) {
+        size_t bytes = sizeof(Header) + (size_t)partitions * (sizeof(Fork) + sizeof(Result)) + (size_t)n * sizeof(Seat);
+        void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) return nullptr;
+        return std::unique_ptr<SharedTable>(new SharedTable(static_cast<char*>(base), bytes, n, partitions));
+    }
+
+    ~SharedTable() {
+        // Only the process that mapped the region tears it down; children leave with _exit()
+        for (int p = 0; p < parts; p++) {
+            forks[p].~Fork();
+            results[p].~Result();
+        }
+        for (int i = 0; i < n; i++) seats[i].~Seat();
+        header->~Header();
+        munmap(base, bytes);
+    }
+
+    SharedTable(const SharedTable&) = delete;
+    SharedTable& operator=(const SharedTable&) = delete;
+
+    int size() const { return n; }
+    int partitions() const { return parts; }
+    int begin(int p) const { return (int)((long long)p * n / parts); }
+
+    Fork& fork(int p) { return forks[p]; }      // the fork at begin(p)
+    Seat& seat(int i) { return seats[i]; }
+    Result& result(int p) { return results[p]; }
+
+    void request_stop() { header->stop.store(true, std::memory_order_relaxed); }
+    bool stopping() const { return header->stop.load(std::memory_order_relaxed); }
+    void set_display(bool on) { header->display.store(on, std::memory_order_relaxed); }
+    bool display() const { return header->display.load(std::memory_order_relaxed); }
+
+    // Takes f, false if running went false first; polls it like the fork-lock arbiters do. A
+    // ticket given up that way is never served, which is fine: the whole table stops with it.
+    static bool take(Fork& f, int id, const std::atomic<bool>& running) {
+        uint32_t ticket = f.next.fetch_add(1, std::memory_order_relaxed);
+        uint32_t now = f.serving.load(std::memory_order_acquire);
+        if (now != ticket) {
+            auto start = std::chrono::steady_clock::now();
+            while (now != ticket) {
+                if (!running.load()) {
+                    f.waited.fetch_add((std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+                    return false;
+                }
+                timespec poll{0, 10000000};
+                futex(f.serving, FUTEX_WAIT, now, &poll);
+                now = f.serving.load(std::memory_order_acquire);
+            }
+            f.waited.fetch_add((std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        }
+        f.owner.store(id, std::memory_order_relaxed);
+        return true;
+    }
+
+    static void release(Fork& f) {
+        f.owner.store(-1, std::memory_order_relaxed);
+        f.serving.fetch_add(1, std::memory_order_release);
+        if (f.next.load(std::memory_order_relaxed) != f.serving.load(std::memory_order_relaxed)) futex(f.serving, FUTEX_WAKE, INT_MAX, nullptr);
+    }
+
+private:
+    struct alignas(cache_line) Header {
+        std::atomic<bool> stop{false};     // set by the parent, or by the first partition to stop
+        std::atomic<bool> display{false};  // the parent draws the table, so publish percentiles
+    };
+
+    // Not FUTEX_PRIVATE_FLAG, which is what std::atomic::wait uses: the waker is another process
+    static void futex(std::atomic<uint32_t>& word, int op, uint32_t value, const timespec* timeout) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, value, timeout, nullptr, 0);
+    }
+
+    SharedTable(char* b, size_t size, int num, int partitions) : base(b), bytes(size), n(num), parts(partitions) {
+        header = new (base) Header();
+        forks = reinterpret_cast<Fork*>(base + sizeof(Header));
+        results = reinterpret_cast<Result*>(base + sizeof(Header) + parts * sizeof(Fork));
+        seats = reinterpret_cast<Seat*>(base + sizeof(Header) + parts * (sizeof(Fork) + sizeof(Result)));
+        for (int p = 0; p < parts; p++) {
+            new (&forks[p]) Fork();
+            new (&results[p]) Result();
+        }
+        for (int i = 0; i < n; i++) new (&seats[i]) Seat();
+    }
+
+    char* base;
+    size_t bytes;
+    int n;
+    int parts;
+    Header* header;
+    Fork* forks;
+    Result* results;
+    Seat* seats;
+};
+
+// The slice of a SharedTable this process runs, set in each child of a partitioned run.
+// Philosophers are numbered locally from 0, so global id = first + local id.
+class Partition {
+public:
+    Partition(SharedTable& t, int p) : shared(t), index(p), first(t.begin(p)), last(t.begin(p + 1) - 1) {}
+
+    SharedTable& shared;
+    int index;
+    int first, last; // global ids of the slice's ends
+
+    SharedTable::Fork& left() { return shared.fork(index); }
+    SharedTable::Fork& right() { return shared.fork((index + 1) % shared.partitions()); }
+
+    static Partition* active;
+};
+
+Partition* Partition::active = nullptr;
+
+// Live table published to a memory-mapped file (--publish FILE), so that viewers in other
+// processes (--view FILE) can attach and detach while the table runs. One thread writes whole
+// frames under a single sequence word; readers copy a frame out and retry while one is being
+// written, so the table never waits for a viewer and does no terminal I/O itself. The file is
+// built under a temporary name and renamed into place, so a viewer still attached to an older
+// run keeps its own mapping and never sees a half-initialised header.
+class StatsFile {
+public:
+    static constexpr uint32_t magic = 0x53544c46; // "FLTS"
+    static constexpr uint32_t version = 1;
+
+    static StatsFile* active; // the table publishes here instead of drawing while this is set
+
+    static std::unique_ptr<StatsFile> create(const std::string& path, int n, const std::string& name) {
+        std::string tmp = path + ".tmp." + std::to_string(getpid());
+        int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return nullptr;
+        size_t bytes = sizeof(Header) + (size_t)n * sizeof(Seat);
+        void* base = ftruncate(fd, (off_t)bytes) == 0 ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            unlink(tmp.c_str());
+            return nullptr;
+        }
+        std::unique_ptr<StatsFile> stats(new StatsFile(static_cast<char*>(base), bytes, true));
+        Header* h = new (base) Header();
+        h->n = n;
+        h->pid = getpid();
+        std::snprintf(h->name, sizeof h->name, "%s", name.c_str());
+        for (int i = 0; i < n; i++) new (&stats->seats[i]) Seat();
+        h->magic.store(magic, std::memory_order_release);
+        if (rename(tmp.c_str(), path.c_str()) != 0) {
+            unlink(tmp.c_str());
+            return nullptr;
+        }
+        return stats;
+    }
+
+    // Maps a file made by create() read-only; on failure returns null and says why in error
+    static std::unique_ptr<StatsFile> attach(const std::string& path, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = "Cannot open " + path + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        struct stat st;
+        void* base = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header)) base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) {
+            error = path + " is not a stats file";
+            return nullptr;
+        }
+        std::unique_ptr<StatsFile> stats(new StatsFile(static_cast<char*>(base), st.st_size, false));
+        const Header& h = *stats->header;
+        if (h.magic.load(std::memory_order_acquire) != magic || h.version != version || h.n < 1 ||
+            (size_t)st.st_size < sizeof(Header) + (size_t)h.n * sizeof(Seat)) {
+            error = path + " is not a stats file of this version";
+            return nullptr;
+        }
+        return stats;
+    }
+
+    ~StatsFile() {
+        if (owner) header->finished.store(true, std::memory_order_release);
+        munmap(base, bytes);
+    }
+
+    StatsFile(const StatsFile&) = delete;
+    StatsFile& operator=(const StatsFile&) = delete;
+
+    int size() const { return header->n; }
+    const char* name() const { return header->name; }
+    bool finished() const { return header->finished.load(std::memory_order_acquire); }
+
+    // False once the publishing process has exited without finishing, e.g. killed
+    bool publisher_alive() const { return kill(header->pid, 0) == 0 || errno == EPERM; }
+
+    // Writer side, one thread only. The view must carry percentiles.
+    void publish(const TableView& view) {
+        Header& h = *header;
+        h.seq.store(h.seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < h.n; i++) {
+            Seat& s = seats[i];
+            s.state = view.state[i];
+            s.fork_owner = view.fork_owner[i];
+            s.eat_count = view.eat_count[i];
+            s.think_count = view.think_count[i];
+            s.queue_rank = 0;
+            s.wait_p50 = view.wait_p50[i];
+            s.wait_p99 = view.wait_p99[i];
+            s.hold_p50 = view.hold_p50[i];
+            s.hold_p99 = view.hold_p99[i];
+        }
+        for (size_t k = 0; k < view.queue.size(); k++) seats[view.queue[k]].queue_rank = (int)k + 1;
+        h.depth_p50 = view.depth_p50;
+        h.depth_p99 = view.depth_p99;
+        h.seq.store(h.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Copies the last complete frame into view; false if the writer kept it busy throughout
+    bool read(TableView& view) const {
+        int n = header->n;
+        view.state.resize(n);
+        view.eat_count.resize(n);
+        view.think_count.resize(n);
+        view.fork_owner.resize(n);
+        view.wait_p50.resize(n);
+        view.wait_p99.resize(n);
+        view.hold_p50.resize(n);
+        view.hold_p99.resize(n);
+        std::vector<std::pair<int, int>>& order = view.ranked;
+        for (int attempt = 0; attempt < max_read_attempts; attempt++) {
+            unsigned before = header->seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            order.clear();
+            for (int i = 0; i < n; i++) {
+                const Seat& s = seats[i];
+                view.state[i] = s.state;
+                view.fork_owner[i] = s.fork_owner;
+                view.eat_count[i] = s.eat_count;
+                view.think_count[i] = s.think_count;
+                view.wait_p50[i] = s.wait_p50;
+                view.wait_p99[i] = s.wait_p99;
+                view.hold_p50[i] = s.hold_p50;
+                view.hold_p99[i] = s.hold_p99;
+                if (s.queue_rank != 0) order.emplace_back(s.queue_rank, i);
+            }
+            view.depth_p50 = header->depth_p50;
+            view.depth_p99 = header->depth_p99;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (header->seq.load(std::memory_order_relaxed) != before) continue;
+            std::sort(order.begin(), order.end());
+            view.queue.clear();
+            for (auto& w : order) view.queue.push_back(w.second);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    static constexpr int max_read_attempts = 1000;
+
+    struct alignas(cache_line) Header {
+        std::atomic<uint32_t> magic{0}; // stored last by create()
+        uint32_t version = StatsFile::version;
+        int32_t n = 0;
+        int32_t pid = 0;
+        char name[64] = {};
+        std::atomic<unsigned> seq{0};   // odd while a frame is being written
+        std::atomic<bool> finished{false};
+        Relaxed<long long> depth_p50{0}, depth_p99{0};
+    };
+
+    struct Seat {
+        Relaxed<State> state{THINKING};
+        Relaxed<int> fork_owner{-1};
+        Relaxed<int> eat_count{0};
+        Relaxed<int> think_count{0};
+        Relaxed<int> queue_rank{0}; // place in the wait queue, 0 when not queued
+        Relaxed<long long> wait_p50{0}, wait_p99{0}, hold_p50{0}, hold_p99{0};
+    };
+
+    StatsFile(char* b, size_t size, bool writer)
+        : base(b), bytes(size), owner(writer), header(reinterpret_cast<Header*>(b)), seats(reinterpret_cast<Seat*>(b + sizeof(Header))) {}
+
+    char* base;
+    size_t bytes;
+    bool owner; // the publishing process, which marks the run finished on the way out
+    Header* header;
+    Seat* seats;
+};
+
+StatsFile* StatsFile::active = nullptr;
+
+// Runs a partition's slice through an ordinary arbiter on a local ring of the same size. The
+// local ring closes over a seam fork between the two end philosophers that stands for the two
+// boundary forks: it keeps them from eating at the same time, which costs a little concurrency
+// at each end but lets the inner arbiter run unchanged. An end philosopher asks the inner arbiter
+// first and takes its boundary fork only once granted, so it waits across processes holding
+// nothing the neighbouring partition could be waiting for.
+class PartitionArbiter : public Arbiter {
+private:
+    std::unique_ptr<Arbiter> inner;
+    Partition& part;
+    const std::atomic<bool>& running;
+    int n;
+
+public:
+    PartitionArbiter(std::unique_ptr<Arbiter> a, Partition& p, int num, const std::atomic<bool>& run)
+        : inner(std::move(a)), part(p), running(run), n(num) {}
+
+    const char* name() const override { return inner->name(); }
+
+    // The boundary fork is taken only once the inner arbiter has granted i, so waiting for it
+    // never holds up the inner queue's order. That cannot deadlock: the other partition's end
+    // philosopher also holds the fork only while it eats, and eating waits for nothing.
+    void pickup(int i) override {
+        inner->pickup(i);
+        if (!running.load()) return;
+        if (i == 0) SharedTable::take(part.left(), part.first, running);
+        if (i == n - 1) SharedTable::take(part.right(), part.last, running);
+    }
+
+    void putdown(int i) override {
+        inner->putdown(i);
+        if (i == 0) SharedTable::release(part.left());
+        if (i == n - 1) SharedTable::release(part.right());
+    }
+
+    void stop() override {
+        // A stopped partition may leave a boundary fork taken, so the whole table stops with it
+        part.shared.request_stop();
+        inner->stop();
+    }
+
+    void snapshot(TableView& view) override { inner->snapshot(view); }
+    long long granted_at(int i) const override { return inner->granted_at(i); }
+    long long lock_wait_ns() const override { return inner->lock_wait_ns(); }
+    WaitCounts wait_counts() const override { return inner->wait_counts(); }
+};
+
+static std::unique_ptr<Arbiter> make_local_arbiter(const Options& opt, const std::atomic<bool>& running) {
+    switch (opt.arbiter) {
+    case ArbiterKind::SHARDED: return std::make_unique<ShardedArbiter>(opt, running);
+    case ArbiterKind::ATOMIC: return std::make_unique<AtomicArbiter>(opt, running);
+    case ArbiterKind::HIERARCHY: return std::make_unique<HierarchyArbiter>(opt, running);
+    case ArbiterKind::WAITER: return std::make_unique<WaiterArbiter>(opt, running);
+    case ArbiterKind::CHANDY_MISRA: return std::make_unique<ChandyMisraArbiter>(opt, running);
+    case ArbiterKind::FIXED:
+        if (opt.n == 5) return std::make_unique<FixedMonitorArbiter<5>>(opt, running);
+        if (opt.n == 64) return std::make_unique<FixedMonitorArbiter<64>>(opt, running);
+        if (opt.n == 1024) return std::make_unique<FixedMonitorArbiter<1024>>(opt, running);
+        break; // main() only allows fixed_size() rings
+    case ArbiterKind::MONITOR: break;
+    }
+    return std::make_unique<MonitorArbiter>(opt, running);
+}
+
+// A ring whose size can change while it runs (--capacity). The topology, meaning the forks,
+// wait queue and everything else an arbiter keeps per philosopher, belongs to an epoch: one inner
+// arbiter built for the current size. grow() builds the next epoch's arbiter on the side, so
+// nobody waits while its records are allocated, and publishes it with one pointer swap. Then it
+// closes the old epoch. The old epoch's parked waiters return and move on to the new one. Its
+// eaters finish their meals and put down there as usual.
+//
+// Every fork in the new epoch starts free. It therefore grants nothing until every earlier epoch
+// has drained, and until then hungry philosophers wait at its gate. That wait is at most the
+// rest of one meal.
+//
+// pickup() and putdown() touch no shared word beyond the inner arbiter's. Each philosopher marks
+// the epoch it is in in its own slot, and that mark doubles as a hazard pointer: an epoch is freed
+// by a later grow() once it has drained and no slot points at it any more. Nobody counts who is
+// inside an open epoch. Closing it counts the slots then marked inside, and only those decrement
+// the count as they leave. Everything else that reads current, such as snapshot(), holds
+// swap_mutex, under which epochs are freed.
+//
+// Philosophers are added next to the last one (between n-1 and 0) and removed from there, so
+// everyone else keeps their index. A seat beyond the ring returns from pickup() without forks
+// (see holds()) and waits in wait_for_seat() until it is filled again.
+class ElasticArbiter : public Arbiter {
+private:
+    enum Phase : int { GATED, OPEN, CLOSED };
+
+    struct Epoch {
+        std::atomic<bool> live{true}; // the inner arbiter's running flag, cleared to evict its waiters
+        std::unique_ptr<Arbiter> table;
+        int n = 0;
+        std::atomic<int> phase{GATED};
+        std::atomic<int> remaining{1};    // once closed: slots counted inside it, plus the closer
+        std::atomic<bool> cleared{false}; // every earlier epoch has drained
+        std::atomic<bool> passed{false};  // cleared has been handed on to successor
+        Epoch* successor = nullptr;       // set before the epoch is closed
+    };
+
+    // Low bits of a slot's mark next to the epoch pointer
+    static constexpr uintptr_t INSIDE = 1;  // between entering the epoch and leaving it
+    static constexpr uintptr_t COUNTED = 2; // in the epoch's remaining count
+
+    static Epoch* epoch_of(uintptr_t mark) { return reinterpret_cast<Epoch*>(mark & ~(INSIDE | COUNTED)); }
+
+    // Philosopher i's view of the ring, written by its own thread only (and mark by a closer)
+    struct Slot {
+        std::atomic<uintptr_t> mark{0}; // the epoch i last entered, with INSIDE and COUNTED
+        bool holding = false;           // granted in that epoch and not put down yet
+        Relaxed<State> state{THINKING};
+        Relaxed<int> eat_count{0};      // over every epoch
+        Relaxed<int> think_count{0};
+    };
+
+    Options opt;
+    int capacity;
+    const std::atomic<bool>& running;
+    RecordArray<Slot> slots;
+    std::atomic<Epoch*> current;
+    std::deque<std::unique_ptr<Epoch>> epochs; // oldest first, current last; under swap_mutex
+    std::atomic<int> size_now;
+    std::atomic<unsigned> seating{0}; // bumped whenever size_now changes, and by stop()
+    mutable std::mutex swap_mutex;    // serialises grow(), stop() and the readers of current
+    bool stopped = false;
+
+    std::unique_ptr<Epoch> build(int size) {
+        auto e = std::make_unique<Epoch>();
+        Options o = opt;
+        o.n = size;
+        o.capacity = 0;
+        e->n = size;
+        e->table = make_local_arbiter(o, e->live);
+        return e;
+    }
+
+    static void close(Epoch& e) {
+        e.phase.store(CLOSED);
+        e.phase.notify_all();
+        e.live.store(false);
+        e.table->stop();
+    }
+
+    // Once e is cleared, closed and empty, nothing can hold its forks any more
+    static void settle(Epoch& e) {
+        if (!e.cleared.load() || e.phase.load() != CLOSED || e.remaining.load() != 0) return;
+        Epoch* next = e.successor; // read first: e may be freed as soon as passed is set
+        if (next && !e.passed.exchange(true)) clear(*next);
+    }
+
+    static void clear(Epoch& e) {
+        e.cleared.store(true);
+        int gated = GATED;
+        if (e.phase.compare_exchange_strong(gated, OPEN)) e.phase.notify_all();
+        settle(e);
+    }
+
+    // Marks i inside the current epoch and returns it. The slot keeps pointing at it after
+    // leave(), so it stays allocated while i may still read it.
+    Epoch* enter(Slot& s) {
+        for (;;) {
+            Epoch* e = current.load();
+            s.mark.store(reinterpret_cast<uintptr_t>(e) | INSIDE);
+            if (current.load() == e) return e; // published after the mark, so no grow() misses it
+            leave(s);
+        }
+    }
+
+    static void leave(Slot& s) {
+        uintptr_t mark = s.mark.load();
+        while (!s.mark.compare_exchange_weak(mark, mark & ~(INSIDE | COUNTED))) {}
+        if ((mark & COUNTED) && epoch_of(mark)->remaining.fetch_sub(1) == 1) settle(*epoch_of(mark));
+    }
+
+    // Counts the slots inside e, which has just been closed, and drops the closer's own count.
+    // A slot marked after the scan passed it sees the epoch closed and leaves uncounted.
+    void drain(Epoch& e) {
+        uintptr_t inside = reinterpret_cast<uintptr_t>(&e) | INSIDE;
+        for (int i = 0; i < capacity; i++) {
+            uintptr_t mark = inside;
+            if (slots[i].mark.compare_exchange_strong(mark, inside | COUNTED)) e.remaining.fetch_add(1);
+        }
+        if (e.remaining.fetch_sub(1) == 1) settle(e);
+    }
+
+    // Frees drained epochs that no slot points at, oldest first, since an epoch being settled
+    // may still clear its successor
+    void reclaim() {
+        while (epochs.size() > 1 && epochs.front()->passed.load()) {
+            Epoch* e = epochs.front().get();
+            for (int i = 0; i < capacity; i++) {
+                if (epoch_of(slots[i].mark.load()) == e) return;
+            }
+            epochs.pop_front();
+        }
+    }
+
+public:
+    ElasticArbiter(const Options& o, const std::atomic<bool>& run)
+        : opt(o), capacity(o.capacity), running(run), slots(o.capacity, o.layout), size_now(o.n) {
+        std::unique_ptr<Epoch> first = build(o.n);
+        first->cleared = true;
+        first->phase = OPEN;
+        current.store(first.get());
+        epochs.push_back(std::move(first));
+    }
+
+    const char* name() const override {
+        std::lock_guard<std::mutex> lock(swap_mutex);
+        return current.load()->table->name();
+    }
+
+    int size() const { return size_now.load(); }
+
+    // Seats or unseats delta philosophers at the end of the ring; false if that would leave it
+    // outside 5..capacity, or once stopped
+    bool grow(int delta) {
+        std::lock_guard<std::mutex> lock(swap_mutex);
+        int size = size_now.load() + delta;
+        if (stopped || delta == 0 || size < 5 || size > capacity) return false;
+        epochs.push_back(build(size));
+        Epoch* next = epochs.back().get();
+        Epoch* old = current.load();
+        old->successor = next;
+        current.store(next);
+        size_now.store(size);
+        seating.fetch_add(1);
+        seating.notify_all();
+        close(*old);
+        drain(*old);
+        reclaim();
+        return true;
+    }
+
+    void pickup(int i) override {
+        Slot& s = slots[i];
+        s.state = HUNGRY;
+        while (running.load()) {
+            Epoch& e = *enter(s);
+            if (i >= e.n) {
+                leave(s);
+                break; // unseated
+            }
+            int phase = e.phase.load();
+            while (phase == GATED) {
+                e.phase.wait(GATED);
+                phase = e.phase.load();
+            }
+            if (phase == OPEN) {
+                e.table->pickup(i);
+                if (e.live.load()) {
+                    s.holding = true;
+                    s.state = EATING;
+                    ++s.eat_count;
+                    return;
+                }
+            }
+            leave(s); // closed, or evicted while waiting in it: try the epoch that replaced it
+        }
+        s.state = THINKING;
+    }
+
+    void putdown(int i) override {
+        Slot& s = slots[i];
+        s.holding = false;
+        s.state = THINKING;
+        ++s.think_count;
+        epoch_of(s.mark.load())->table->putdown(i);
+        leave(s);
+    }
+
+    // The size of the ring the last pickup() by i was granted in, 0 if it was cut short by i
+    // being unseated instead; by i itself, which keeps that epoch alive until its next pickup()
+    int holds(int i) const { return slots[i].holding ? epoch_of(slots[i].mark.load())->n : 0; }
+
+    // Blocks until i is part of the ring again, or until stop()
+    void wait_for_seat(int i) {
+        slots[i].mark.store(0); // left its last epoch in pickup(); let it be freed meanwhile
+        unsigned seen = seating.load();
+        while (i >= size_now.load() && running.load()) {
+            seating.wait(seen);
+            seen = seating.load();
+        }
+    }
+
+    void stop() override {
+        std::lock_guard<std::mutex> lock(swap_mutex);
+        stopped = true;
+        close(*current.load());
+        seating.fetch_add(1);
+        seating.notify_all();
+    }
+
+    void snapshot(TableView& view) override {
+        std::lock_guard<std::mutex> lock(swap_mutex);
+        Epoch* e = current.load();
+        e->table->snapshot(view);
+        int n = e->n;
+        if (!e->cleared.load()) {
+            // The new epoch has granted nothing yet; show who still eats or waits in the old one
+            std::fill(view.fork_owner.begin(), view.fork_owner.end(), -1);
+            view.queue.clear();
+            for (int i = 0; i < n; i++) {
+                view.state[i] = slots[i].state;
+                if (view.state[i] == EATING) view.fork_owner[i] = view.fork_owner[(i + 1) % n] = i;
+                else if (view.state[i] == HUNGRY) view.queue.push_back(i);
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            view.eat_count[i] = slots[i].eat_count;
+            view.think_count[i] = slots[i].think_count;
+        }
+    }
+
+    // By i itself, right after its pickup(), while its slot still points at the granting epoch
+    long long granted_at(int i) const override {
+        Epoch* e = epoch_of(slots[i].mark.load());
+        return e ? e->table->granted_at(i) : 0;
+    }
+
+    // Of the current epoch only
+    long long lock_wait_ns() const override {
+        std::lock_guard<std::mutex> lock(swap_mutex);
+        return current.load()->table->lock_wait_ns();
+    }
+
+    WaitCounts wait_counts() const override {
+        std::lock_guard<std::mutex> lock(swap_mutex);
+        return current.load()->table->wait_counts();
+    }
+};
+
+static std::unique_ptr<Arbiter> make_arbiter(const Options& opt, const std::atomic<bool>& running) {
+    if (opt.capacity > 0) return std::make_unique<ElasticArbiter>(opt, running);
+    std::unique_ptr<Arbiter> table = make_local_arbiter(opt, running);
+    if (Partition::active) return std::make_unique<PartitionArbiter>(std::move(table), *Partition::active, opt.n, running);
+    return table;
+}
+
+// Hashed timer wheel for the pool engine's think/eat deadlines. A philosopher has at most one
+// pending deadline, so entries are linked through per-philosopher slots and never allocate.
+// Deadlines are rounded up to whole ticks; ones further out than a full turn wait for rounds.
+class TimerWheel {
+public:
+    using clock = std::chrono::steady_clock;
+
+    TimerWheel(int n, std::chrono::nanoseconds resolution)
+        : tick(std::max<std::chrono::nanoseconds>(resolution, std::chrono::microseconds(1))),
+          start(clock::now()), head(slots, -1), next(n, -1), rounds(n, 0) {}
+
+    void schedule(int i, std::chrono::nanoseconds delay) {
+        std::lock_guard<std::mutex> lock(mtx);
+        long long target = (clock::now() - start + delay + tick - std::chrono::nanoseconds(1)) / tick;
+        if (target <= cursor) target = cursor + 1;
+        int slot = (int)(target % slots);
+        rounds[i] = (target - cursor - 1) / slots;
+        next[i] = head[slot];
+        head[slot] = i;
+    }
+
+    // Processes every tick that has elapsed by now and appends the expired philosophers to out
+    void advance(std::vector<int>& out) {
+        std::lock_guard<std::mutex> lock(mtx);
+        long long now_tick = (clock::now() - start) / tick;
+        while (cursor < now_tick) {
+            ++cursor;
+            int slot = (int)(cursor % slots);
+            int* link = &head[slot];
+            while (*link != -1) {
+                int i = *link;
+                if (rounds[i] == 0) {
+                    *link = next[i];
+                    out.push_back(i);
+                } else {
+                    --rounds[i];
+                    link = &next[i];
+                }
+            }
+        }
+    }
+
+    clock::time_point next_tick() const {
+        return start + tick * ((clock::now() - start) / tick + 1);
+    }
+
+private:
+    static constexpr int slots = 4096;
+
+    std::mutex mtx;
+    std::chrono::nanoseconds tick;
+    clock::time_point start;
+    long long cursor = 0; // last tick processed
+    std::vector<int> head;
+    std::vector<int> next;
+    std::vector<long long> rounds;
+};
+
+// Philosophers whose next step can run now: expired timers and grants made by putdown()
+class ReadyQueue {
+public:
+    void push(int i) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            append(i);
+        }
+        cv.notify_one();
+    }
+
+    void push_all(const std::vector<int>& ids) {
+        if (ids.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (int id : ids) append(id);
+        }
+        if (ids.size() == 1) cv.notify_one();
+        else cv.notify_all();
+    }
+
+    // Room for n queued ids up front, so that append() never grows the ring while the bench counts
+    void reserve(int n) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (count == 0 && ring.size() < (size_t)n) {
+            ring.assign(n, 0);
+            head = 0;
+        }
+    }
+
+    // Blocks until an id is available; false once the queue has been closed
+    bool pop(int& i) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&]{ return count > 0 || closed; });
+        if (closed) return false;
+        i = ring[head];
+        head = (head + 1) % ring.size();
+        --count;
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closed = true;
+        }
+        cv.notify_all();
+    }
+
+private:
+    // Requires mtx to be held. Every philosopher is queued at most once, so the ring stops
+    // growing at n entries and the steady state does not allocate, unlike a std::deque.
+    void append(int i) {
+        if (count == ring.size()) {
+            std::vector<int> grown(std::max<size_t>(16, 2 * ring.size()));
+            for (size_t k = 0; k < count; k++) grown[k] = ring[(head + k) % ring.size()];
+            ring.swap(grown);
+            head = 0;
+        }
+        ring[(head + count) % ring.size()] = i;
+        ++count;
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<int> ring;
+    size_t head = 0;
+    size_t count = 0;
+    bool closed = false;
+};
+
+class AsyncTable;
+
+// Coroutine run by the CORO engine, one per philosopher. It starts suspended so that the engine
+// decides on which worker it first runs, and stays suspended at the end until destroyed.
+struct PhilosopherTask {
+    struct promise_type {
+        AsyncTable* table = nullptr;
+        int id = -1;
+
+        PhilosopherTask get_return_object() {
+            return PhilosopherTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+using PhilosopherHandle = std::coroutine_handle<PhilosopherTask::promise_type>;
+
+// Awaitable front end of an Arbiter. A suspended philosopher costs its coroutine frame; whatever
+// makes it runnable again (a grant from putdown(), an expired deadline) puts its id on the ready
+// queue and a worker resumes the frame, with no condition variable involved.
+class AsyncTable {
+public:
+    AsyncTable(Arbiter& a, ReadyQueue& r, TimerWheel& t, int n) : arbiter(a), ready(r), timers(t), tasks(n) {}
+
+    ~AsyncTable() {
+        // Workers have been joined by now; frames may be suspended anywhere
+        for (auto& h : tasks) {
+            if (h) h.destroy();
+        }
+    }
+
+    void attach(int id, PhilosopherTask task) {
+        task.handle.promise().table = this;
+        task.handle.promise().id = id;
+        tasks[id] = task.handle;
+        ready.push(id);
+    }
+
+    void resume(int id) {
+        if (!tasks[id].done()) tasks[id].resume();
+    }
+
+    struct PickupAwaiter {
+        AsyncTable& table;
+        int id;
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<>) {
+            // Once request() has returned false the grant may already be resuming us on another worker
+            return !table.arbiter.request(id);
+        }
+        void await_resume() const noexcept {}
+    };
+
+    PickupAwaiter pickup(int id) { return PickupAwaiter{*this, id}; }
+
+    void wake_after(int id, std::chrono::nanoseconds delay) { timers.schedule(id, delay); }
+
+private:
+    Arbiter& arbiter;
+    ReadyQueue& ready;
+    TimerWheel& timers;
+    std::vector<PhilosopherHandle> tasks;
+};
+
+struct SleepAwaiter {
+    std::chrono::nanoseconds delay;
+
+    bool await_ready() const noexcept { return delay.count() <= 0; }
+    void await_suspend(PhilosopherHandle h) {
+        h.promise().table->wake_after(h.promise().id, delay);
+    }
+    void await_resume() const noexcept {}
+};
+
+// co_await sleep_for(d) inside a PhilosopherTask; a zero delay does not suspend
+inline SleepAwaiter sleep_for(std::chrono::nanoseconds delay) { return SleepAwaiter{delay}; }
+
+// Draws TableView frames with ncurses, touching only the cells that changed since the previous
+// frame. Both tables show the same window of rows [top, top + rows), sized to the terminal;
+// a full redraw only happens when the layout changes (first frame, resize, scrolling).
+class Renderer {
+private:
+    static constexpr int fixed_lines = 10; // everything except the two table windows
+    static constexpr int unknown = -2;     // cache value that never matches a real cell
+
+    int n;
+    bool seating; // --capacity: '+' and '-' add and remove philosophers
+    int top = 0;
+    int rows = 0;
+    int lines = -1, cols = -1, drawn_top = -1;
+    std::vector<int> last_state, last_eat, last_think, last_owner;
+    std::vector<long long> last_wait50, last_wait99, last_hold50, last_hold99;
+    std::vector<int> last_queue;
+    long long last_depth50 = unknown, last_depth99 = unknown;
+    bool queue_valid = false;
+    std::string last_locks;
+
+    int table_rows() const { return std::max(1, std::min(n, (LINES - fixed_lines) / 2)); }
+    int queue_line() const { return 5 + rows; }
+    int forks_line() const { return 8 + rows; }
+
+    static const char* state_name(State st) {
+        return (st == THINKING) ? "THINKING" : (st == HUNGRY) ? "HUNGRY" : "EATING";
+    }
+
+    // At most seven characters: 850ns, 12.3us, 1.5ms, 2.0s; "-" before the first sample
+    static std::string short_duration(long long ns) {
+        char buf[16];
+        if (ns <= 0) return "-";
+        if (ns < 1000) std::snprintf(buf, sizeof buf, "%lldns", ns);
+        else if (ns < 1000000) std::snprintf(buf, sizeof buf, "%.1fus", (double)ns / 1e3);
+        else if (ns < 1000000000) std::snprintf(buf, sizeof buf, "%.1fms", (double)ns / 1e6);
+        else std::snprintf(buf, sizeof buf, "%.1fs", (double)ns / 1e9);
+        return buf;
+    }
+
+    static void draw_duration(long long& last, long long ns, int line, int col) {
+        if (last == ns) return;
+        last = ns;
+        mvprintw(line, col, "%8s", short_duration(ns).c_str());
+    }
+
+    void relayout(const char* name) {
+        rows = table_rows();
+        top = std::max(0, std::min(top, n - rows));
+        lines = LINES;
+        cols = COLS;
+        drawn_top = top;
+        std::fill(last_state.begin(), last_state.end(), unknown);
+        std::fill(last_eat.begin(), last_eat.end(), unknown);
+        std::fill(last_think.begin(), last_think.end(), unknown);
+        std::fill(last_owner.begin(), last_owner.end(), unknown);
+        for (auto* last : {&last_wait50, &last_wait99, &last_hold50, &last_hold99}) std::fill(last->begin(), last->end(), unknown);
+        last_depth50 = last_depth99 = unknown;
+        queue_valid = false;
+        last_locks.clear();
+
+        erase();
+        mvprintw(0, 0, "=== Dining Philosophers (%d, %s) ===", n, name);
+        if (rows < n) mvprintw(2, 0, "Philosophers %d-%d of %d (arrows/PgUp/PgDn scroll):", top, top + rows - 1, n);
+        else mvprintw(2, 0, "Philosophers:");
+        mvprintw(3, 0, "Idx  State       Ate  Thought  Wait p50     p99  Hold p50     p99");
+        for (int r = 0; r < rows; r++) mvprintw(4 + r, 0, "  %2d", top + r);
+        mvprintw(queue_line(), 0, "Waiting queue (front -> back):");
+        mvprintw(forks_line() - 1, 0, "Forks (between i and i+1):");
+        if (seating) mvprintw(forks_line() + rows + 1, 0, "Press Ctrl+C or 'q' to exit, '+'/'-' to add/remove a philosopher");
+        else mvprintw(forks_line() + rows + 1, 0, "Press Ctrl+C or 'q' to exit");
+    }
+
+    void draw_locks(const LockProfile::Totals& locks) {
+        std::string text = "Lock hold/wait:";
+        for (int k = 0; k < (int)LockSite::COUNT; k++) {
+            const LockProfile::Site& s = locks.sites[k];
+            text += std::string(k ? ", " : " ") + LockProfile::site_names[k] + " " + short_duration(s.hold_ns) + "/" +
+                    short_duration(s.wait_ns) + " (" + std::to_string(s.handoffs) + " hand-offs)";
+        }
+        if (text == last_locks) return;
+        last_locks = text;
+        move(1, 0);
+        clrtoeol();
+        mvaddnstr(1, 0, text.c_str(), cols);
+    }
+
+    void draw_queue(const TableView& view) {
+        if (last_depth50 != view.depth_p50 || last_depth99 != view.depth_p99) {
+            last_depth50 = view.depth_p50;
+            last_depth99 = view.depth_p99;
+            move(queue_line(), 31);
+            clrtoeol();
+            mvprintw(queue_line(), 31, "  depth p50 %lld, p99 %lld", view.depth_p50, view.depth_p99);
+        }
+        const std::vector<int>& queue = view.queue;
+        if (queue_valid && queue == last_queue) return;
+        last_queue = queue;
+        queue_valid = true;
+        move(queue_line() + 1, 0);
+        clrtoeol();
+        if (queue.empty()) {
+            mvprintw(queue_line() + 1, 0, "  empty");
+            return;
+        }
+        int col = 0;
+        for (int id : queue) {
+            if (col + 6 > cols) {
+                mvprintw(queue_line() + 1, col, "...");
+                break;
+            }
+            mvprintw(queue_line() + 1, col, "%d ", id);
+            col += 3 + (id >= 100) + (id >= 1000) + (id >= 10000);
+        }
+    }
+
+public:
+    explicit Renderer(int num, bool resizable = false)
+        : n(num), seating(resizable), last_state(num, unknown), last_eat(num, unknown), last_think(num, unknown), last_owner(num, unknown),
+          last_wait50(num, unknown), last_wait99(num, unknown), last_hold50(num, unknown), last_hold99(num, unknown) {}
+
+    // A ring of num philosophers from the next frame on, laid out again from scratch
+    void resize(int num) {
+        n = num;
+        for (auto* last : {&last_state, &last_eat, &last_think, &last_owner}) last->resize(num);
+        for (auto* last : {&last_wait50, &last_wait99, &last_hold50, &last_hold99}) last->resize(num);
+        lines = -1;
+    }
+
+    void scroll_rows(int delta) { top = std::max(0, std::min(top + delta, n - table_rows())); }
+    void scroll_pages(int pages) { scroll_rows(pages * table_rows()); }
+
+    // Applies the key presses waiting in the terminal; true once 'q' was pressed. With seating,
+    // '+' and '-' add one to and take one from *seats.
+    bool handle_keys(int* seats = nullptr) {
+        bool quit = false;
+        for (int ch = getch(); ch != ERR; ch = getch()) {
+            if (ch == 'q' || ch == 'Q') quit = true;
+            else if (seating && seats && (ch == '+' || ch == '=')) ++*seats;
+            else if (seating && seats && ch == '-') --*seats;
+            else if (ch == KEY_UP) scroll_rows(-1);
+            else if (ch == KEY_DOWN) scroll_rows(1);
+            else if (ch == KEY_PPAGE) scroll_pages(-1);
+            else if (ch == KEY_NPAGE) scroll_pages(1);
+            else if (ch == KEY_HOME) scroll_rows(-n);
+            else if (ch == KEY_END) scroll_rows(n);
+        }
+        return quit;
+    }
+
+    // locks, if given, goes on the line under the title: hold/wait time and hand-offs per site
+    void draw(const TableView& view, const char* name, const LockProfile::Totals* locks = nullptr) {
+        if ((int)view.state.size() != n) resize((int)view.state.size());
+        if (lines != LINES || cols != COLS || drawn_top != top) relayout(name);
+        if (locks) draw_locks(*locks);
+
+        for (int r = 0; r < rows; r++) {
+            int i = top + r;
+            int line = 4 + r;
+            if (last_state[i] != view.state[i]) {
+                last_state[i] = view.state[i];
+                mvprintw(line, 6, "%-10s", state_name(view.state[i]));
+            }
+            if (last_eat[i] != view.eat_count[i]) {
+                last_eat[i] = view.eat_count[i];
+                mvprintw(line, 18, "%4d", view.eat_count[i]);
+            }
+            if (last_think[i] != view.think_count[i]) {
+                last_think[i] = view.think_count[i];
+                mvprintw(line, 24, "%7d", view.think_count[i]);
+            }
+            draw_duration(last_wait50[i], view.wait_p50[i], line, 33);
+            draw_duration(last_wait99[i], view.wait_p99[i], line, 41);
+            draw_duration(last_hold50[i], view.hold_p50[i], line, 51);
+            draw_duration(last_hold99[i], view.hold_p99[i], line, 59);
+            if (last_owner[i] != view.fork_owner[i]) {
+                last_owner[i] = view.fork_owner[i];
+                int owner = view.fork_owner[i];
+                move(forks_line() + r, 0);
+                clrtoeol();
+                if (owner == -1) {
+                    mvprintw(forks_line() + r, 0, "  Fork %2d-%-2d: free", i, (i + 1) % n);
+                } else {
+                    mvprintw(forks_line() + r, 0, "  Fork %2d-%-2d: held by %d", i, (i + 1) % n, owner);
+                }
+            }
+        }
+        draw_queue(view);
+
+        wnoutrefresh(stdscr);
+        doupdate();
+    }
+};
+
+// Interruptible sleep for the table's threads: raise() wakes every sleeper at once, so a stopped
+// run does not wait out anyone's think or eat time. raise() is one atomic store and a futex
+// wake, both async-signal-safe, so a signal handler may call it where it could not call stop().
+class StopSignal {
+public:
+    void raise() {
+        word.store(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    bool raised() const { return word.load(std::memory_order_acquire) != 0; }
+
+    // Sleeps for d; false if raise() cut it short
+    bool sleep_for(std::chrono::nanoseconds d) {
+        auto deadline = std::chrono::steady_clock::now() + d;
+        while (!raised()) {
+            auto left = deadline - std::chrono::steady_clock::now();
+            if (left.count() <= 0) return true;
+            timespec timeout{(time_t)(left.count() / 1000000000), (long)(left.count() % 1000000000)};
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, 0, &timeout, nullptr, 0);
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint32_t> word{0};
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+};
+
+// The eating phase (--work). SLEEP only waits. SPIN runs an xorshift loop. TOUCH increments one
+// word in every cache line of the buffers of both forks, so a fork that changes hands moves its
+// lines to the new holder's core, as data guarded by the forks would. Both busy kinds run for the
+// drawn eat time, so --eat, trace:FILE included, sets how long they work. They check the clock
+// and halt once per chunk. TOUCH always makes one pass, even with no eat time.
+class Workload {
+public:
+    Workload(const Options& o, int forks)
+        : kind(o.work), count(forks), stride((o.touch_bytes + cache_line - 1) / cache_line * cache_line), tallies(forks, o.layout) {
+        if (kind != WorkKind::TOUCH) return;
+        buffers = static_cast<char*>(::operator new((size_t)count * stride, std::align_val_t(cache_line)));
+        std::memset(buffers, 0, (size_t)count * stride);
+        if (Placement::active) Placement::active->bind(buffers, count, stride);
+    }
+
+    ~Workload() {
+        if (buffers) ::operator delete(buffers, std::align_val_t(cache_line));
+    }
+
+    Workload(const Workload&) = delete;
+    Workload& operator=(const Workload&) = delete;
+
+    bool sleeps() const { return kind == WorkKind::SLEEP; }
+
+    // Philosopher i eats for d with forks i and right; false if halt cut the meal short
+    bool eat(int i, int right, std::chrono::nanoseconds d, StopSignal& halt) {
+        if (kind == WorkKind::SLEEP) return d.count() <= 0 || halt.sleep_for(d);
+        auto start = std::chrono::steady_clock::now(), at = start, deadline = start + d;
+        Tally& t = tallies[i];
+        for (bool once = kind == WorkKind::TOUCH; once || at < deadline; once = false) {
+            if (halt.raised()) return false;
+            if (kind == WorkKind::SPIN) {
+                spin(t);
+            } else {
+                touch(i);
+                touch(right);
+                ++t.passes;
+            }
+            at = std::chrono::steady_clock::now();
+        }
+        t.busy_ns = t.busy_ns + (at - start).count();
+        return true;
+    }
+
+    // Bench report lines; empty for SLEEP
+    std::string describe(int philosophers) const {
+        if (kind == WorkKind::SLEEP) return "";
+        long long busy = 0;
+        unsigned long long passes = 0;
+        for (int i = 0; i < philosophers; i++) {
+            busy += tallies[i].busy_ns;
+            passes += tallies[i].passes;
+        }
+        char line[256];
+        if (kind == WorkKind::SPIN) {
+            std::snprintf(line, sizeof line, "work             spin, %.3f s busy\n", (double)busy / 1e9);
+        } else {
+            // One word is stored per line, but the whole line moves to the eater's core
+            double lines = (double)passes * 2.0 * (double)(stride / cache_line);
+            std::snprintf(line, sizeof line, "work             touch %zu bytes per fork, %llu passes, %.1f M cache lines dirtied at %.1f M/s while eating\n",
+                          stride, passes, lines / 1e6, busy > 0 ? lines * 1e3 / (double)busy : 0.0);
+        }
+        return line;
+    }
+
+private:
+    struct Tally {
+        Relaxed<long long> busy_ns{0};
+        Relaxed<unsigned long long> passes{0};
+        Relaxed<uint64_t> sink{0}; // SPIN: keeps the loop from being optimised away
+    };
+
+    WorkKind kind;
+    int count;
+    size_t stride;
+    char* buffers = nullptr;
+    RecordArray<Tally> tallies;
+
+    static constexpr int spin_chunk = 4096; // xorshift rounds between clock checks
+
+    static void spin(Tally& t) {
+        uint64_t x = t.sink | 1;
+        for (int k = 0; k < spin_chunk; k++) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+        }
+        t.sink = x;
+    }
+
+    void touch(int fork) {
+        char* buffer = buffers + (size_t)fork * stride;
+        for (size_t at = 0; at < stride; at += cache_line) ++*reinterpret_cast<uint64_t*>(buffer + at);
+    }
+};
+
+// One row of the --arbiter all comparison or of a sweep
+struct BenchSummary {
+    std::string arbiter;
+    long meals = 0;
+    double elapsed_s = 0; // virtual seconds on the SIM engine
+    double wall_s = 0;
+    double meals_per_s = 0;
+    double fairness = 0;
+    double wait_p50_us = 0, wait_p99_us = 0, wait_p999_us = 0, wait_max_us = 0;
+    double hold_p99_us = 0;
+    double lock_wait_ms = 0;
+};
+
+class DiningPhilosophers {
+private:
+    Options opt;
+    int n; // seats: the ring's size, or --capacity
+    std::unique_ptr<Arbiter> table;
+    ElasticArbiter* elastic = nullptr; // table, under --capacity
+    TableView view; // display_loop() only
+    Renderer renderer;
+    std::mutex display_mutex;
+    std::atomic<bool> running;
+    std::atomic<long> total_meals{0};
+    BenchSummary summary; // filled by report()
+    unsigned long long run_allocations = 0;    // heap allocations between start-up and stop()
+    unsigned long long sample_growth = 0;      // not among them: the bench's sample vectors growing
+    std::unique_ptr<std::latch> warmed;        // counted down by each engine thread once it is ready
+    std::string notice; // printed to stderr once the table is torn down
+
+    // POOL engine: each philosopher has at most one pending step, either a deadline in the
+    // timer wheel or an entry in the ready queue, so only one worker touches it at a time
+    enum class Phase : unsigned char { THINK, WAIT, EAT };
+
+    // Everything the driver keeps per philosopher, touched only by whoever is currently running
+    // it (its own thread, or the one worker holding its step)
+    struct Seat {
+        Rng rng;
+        size_t think_cursor = 0;
+        size_t eat_cursor = 0;
+        Phase phase = Phase::THINK;
+        std::chrono::steady_clock::time_point hungry_at;
+        long long held_since = 0;         // steady_clock ns of the current grant
+        std::vector<long long> wait_ns;   // bench: HUNGRY -> EATING samples
+        std::vector<long long> wakeup_ns; // bench: grant by a neighbour -> running again
+        std::vector<uint8_t> drawn[2];    // --record: think and eat durations, as Recording streams
+        std::vector<uint64_t> grants;     // --record, --replay: this philosopher's places in the grant order
+    };
+    RecordArray<Seat> seats;
+
+    // Written by whoever runs the philosopher, read by the renderer and the report
+    struct Latency {
+        SeatHistogram wait; // HUNGRY -> EATING
+        SeatHistogram hold; // grant -> putdown()
+    };
+    RecordArray<Latency> latency;
+    Histogram spilled_wait, spilled_hold; // what the seats' histograms halved away
+    std::mutex spill_mutex;
+    Workload work; // the eating phase
+    Histogram queue_depth; // sampled by display_loop() or bench_wait(), its only writer
+
+    // Metrics exporter thread only
+    TableView scrape_view;
+    long scraped_meals = 0;
+    std::chrono::steady_clock::time_point scraped_at = std::chrono::steady_clock::now();
+
+    // --record and --replay: grants are numbered in the order the driver sees them
+    std::atomic<uint64_t> grant_seq{0};
+    std::atomic<int> replay_end{-1}; // first philosopher whose recording ran out
+
+    ReadyQueue ready;
+    std::unique_ptr<TimerWheel> timers;
+    std::unique_ptr<AsyncTable> async_table; // CORO engine
+
+    // SIM engine: pending steps ordered by virtual time, then by when they were scheduled
+    struct SimEvent {
+        long long at;
+        uint64_t seq;
+        int id;
+        bool operator>(const SimEvent& o) const { return at != o.at ? at > o.at : seq > o.seq; }
+    };
+    std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent>> events;
+    long long sim_now = 0; // virtual ns since the start of the run
+    uint64_t sim_seq = 0;
+    double sim_wall_s = 0;
+
+    // steady_clock, or virtual time on the SIM engine
+    std::chrono::steady_clock::time_point now() const {
+        if (opt.exec == ExecMode::SIM) return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(sim_now));
+        return std::chrono::steady_clock::now();
+    }
+
+    // ^C only raises halt: stop() takes arbiter locks, which the interrupted thread may hold.
+    // Whichever thread supervises the run (display, publisher or bench loop) wakes from its
+    // sleep, sees halt raised while still running, and calls stop() itself.
+    StopSignal halt;
+    static std::atomic<DiningPhilosophers*> instance; // read by the handler, so lock-free
+    static_assert(std::atomic<DiningPhilosophers*>::is_always_lock_free);
+    static void handle_sigint(int) {
+        if (DiningPhilosophers* dp = instance.load()) dp->halt.raise();
+    }
+
+    bool interrupted() const { return halt.raised() && running.load(); }
+
+    // ncurses is only started for the interactive table; under --publish viewers draw it
+    bool draws() const { return !opt.bench && !StatsFile::active; }
+
+    void pickup(int i) { table->pickup(i); }
+
+    // The fork philosopher i shares with the next one, whose buffer it touches while eating. Under
+    // --capacity that is in the ring i was granted in, which a resize since may have changed.
+    int right_of(int i) const { return (i + 1) % (elastic ? elastic->holds(i) : n); }
+
+    void putdown(int i) {
+        latency[i].hold.record(now().time_since_epoch().count() - seats[i].held_since, spilled_hold, spill_mutex);
+        table->putdown(i);
+    }
+
+    bool recording() const { return !opt.record_path.empty(); }
+
+    std::chrono::nanoseconds draw(int id, Recording::Stream stream, const Distribution& dist, size_t& cursor) {
+        Seat& s = seats[id];
+        if (Recording::active) {
+            long long ns = 0;
+            if (!Recording::active->next(id, stream, cursor, ns)) {
+                // The first philosopher to run out of recorded durations ends the replay
+                int none = -1;
+                replay_end.compare_exchange_strong(none, id);
+                stop();
+            }
+            return std::chrono::nanoseconds(ns);
+        }
+        std::chrono::nanoseconds d = dist.sample(s.rng, cursor);
+        if (recording()) {
+            SampleAllocations scope;
+            Recording::append(s.drawn[stream], (uint64_t)d.count());
+        }
+        return d;
+    }
+
+    std::chrono::nanoseconds think_time(int id) { return draw(id, Recording::THINK, opt.think, seats[id].think_cursor); }
+    std::chrono::nanoseconds eat_time(int id) { return draw(id, Recording::EAT, opt.eat, seats[id].eat_cursor); }
+
+    // Grant order seen by the driver, assembled from every philosopher's numbered grants
+    std::vector<int> grant_order() const {
+        std::vector<int> order(grant_seq.load(), -1);
+        for (int i = 0; i < n; i++) {
+            for (uint64_t g : seats[i].grants) order[g] = i;
+        }
+        return order;
+    }
+
+    void record_wait(int id, std::chrono::steady_clock::time_point hungry_at) {
+        auto at = now();
+        long long wait = std::chrono::duration_cast<std::chrono::nanoseconds>(at - hungry_at).count();
+        long long granted = table->granted_at(id);
+        latency[id].wait.record(wait, spilled_wait, spill_mutex);
+        seats[id].held_since = granted != 0 ? granted : at.time_since_epoch().count();
+        SampleAllocations scope;
+        if (recording() || Recording::active) seats[id].grants.push_back(grant_seq.fetch_add(1, std::memory_order_relaxed));
+        if (opt.bench && opt.samples) {
+            seats[id].wait_ns.push_back(wait);
+            if (granted != 0) seats[id].wakeup_ns.push_back(at.time_since_epoch().count() - granted);
+        }
+    }
+
+    // Sizes the view the bench samples the queue through and waits for the engine's threads to
+    // size theirs, so that the allocations it counts are the meals' alone
+    void reserve_samples() {
+        if (warmed) warmed->wait(); // every engine thread has its buffers
+        else Arbiter::warm_wake_list(); // SIM: this thread runs every step
+        view.queue.reserve(n);
+        view.waiting.reserve(n);
+        table->snapshot(view);
+    }
+
+    void sample_queue() {
+        // Requires view to hold a fresh snapshot
+        queue_depth.record((long long)view.queue.size());
+        view.depth_p50 = queue_depth.percentile(0.50);
+        view.depth_p99 = queue_depth.percentile(0.99);
+    }
+
+    void meal_done() {
+        if (opt.meals > 0 && total_meals.fetch_add(1, std::memory_order_relaxed) + 1 >= opt.meals) stop();
+    }
+
+    void philosopher(int id) {
+        if (Placement::active) Placement::pin_current_thread(Placement::active->cpu_of(id).id);
+        Arbiter::warm_wake_list();
+        warmed->count_down();
+        while (running) {
+            if (elastic && id >= elastic->size()) {
+                elastic->wait_for_seat(id);
+                continue;
+            }
+
+            // Thinking
+            auto think = think_time(id);
+            if (think.count() > 0 && !halt.sleep_for(think)) break;
+
+            // Eating
+            auto hungry_at = std::chrono::steady_clock::now();
+            pickup(id);
+            if (!running.load()) break; // exit early if stop was requested while waiting
+            if (elastic && !elastic->holds(id)) continue; // unseated while waiting
+            record_wait(id, hungry_at);
+            auto eat = eat_time(id);
+            if (!work.eat(id, right_of(id), eat, halt)) break; // a meal cut short is not counted
+            putdown(id);
+            meal_done();
+        }
+    }
 
-    static DiningPhilosophers* instance;
-    static void handle_sigint(int) {
-        if (instance) instance->stop();
+    void after(int id, std::chrono::nanoseconds delay) {
+        if (opt.exec == ExecMode::SIM) events.push(SimEvent{sim_now + delay.count(), sim_seq++, id});
+        else if (delay.count() > 0) timers->schedule(id, delay);
+        else ready.push(id);
     }
 
-    void test_front() {
-        // Requires mtx to be held; serves requests in FIFO to prevent starvation
-        if (wait_queue.empty()) return;
-        int i = wait_queue.front();
-        if (state[i] == HUNGRY && state[(i - 1 + n) % n] != EATING && state[(i + 1) % n] != EATING) {
-            wait_queue.pop_front();
-            in_queue[i] = false;
-            state[i] = EATING;
-            ++eat_count[i];
-            fork_owner[i] = i;
-            fork_owner[(i + 1) % n] = i;
-            cv[i].notify_one();
+    void step(int id) {
+        Seat& p = seats[id];
+        switch (p.phase) {
+        case Phase::THINK: // thinking is over
+            p.phase = Phase::WAIT;
+            p.hungry_at = now();
+            if (!table->request(id)) return; // the grant hook puts id back on the ready queue
+            [[fallthrough]];
+        case Phase::WAIT: // forks granted
+            record_wait(id, p.hungry_at);
+            p.phase = Phase::EAT;
+            if (work.sleeps()) after(id, eat_time(id));
+            else if (work.eat(id, right_of(id), eat_time(id), halt)) after(id, std::chrono::nanoseconds(0)); // ate on this worker
+            return;
+        case Phase::EAT: // eating is over
+            putdown(id);
+            meal_done();
+            p.phase = Phase::THINK;
+            after(id, think_time(id));
+            return;
         }
     }
 
-    void pickup(int i) {
-        std::unique_lock<std::mutex> lock(mtx);
-        if (!in_queue[i]) {
-            wait_queue.push_back(i);
-            in_queue[i] = true;
+    PhilosopherTask coro_philosopher(int id) {
+        AsyncTable& async = *async_table;
+        while (running) {
+            co_await sleep_for(think_time(id));
+
+            auto hungry_at = std::chrono::steady_clock::now();
+            co_await async.pickup(id);
+            if (!running.load()) break;
+            record_wait(id, hungry_at);
+            auto eat = eat_time(id);
+            if (work.sleeps()) co_await sleep_for(eat);
+            else if (!work.eat(id, right_of(id), eat, halt)) break; // ate on this worker
+            putdown(id);
+            meal_done();
         }
-        state[i] = HUNGRY;
-        test_front();
-        cv[i].wait(lock, [&]{ return state[i] == EATING || !running.load(); });
     }
 
-    void putdown(int i) {
-        std::lock_guard<std::mutex> lock(mtx);
-        state[i] = THINKING;
-        ++think_count[i];
-        fork_owner[i] = -1;
-        fork_owner[(i + 1) % n] = -1;
-        test_front();
+    void pool_worker(int w, int workers) {
+        if (Placement::active) Placement::pin_current_thread(Placement::active->cpu_of_worker(w, workers).id);
+        Arbiter::warm_wake_list();
+        warmed->count_down();
+        int id;
+        while (running && ready.pop(id)) {
+            if (async_table) async_table->resume(id);
+            else step(id);
+        }
     }
 
-    void philosopher(int id) {
+    void timer_loop() {
+        std::vector<int> expired;
+        expired.reserve(n);
+        warmed->count_down();
         while (running) {
-            // Thinking
-            std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 2000 + 1000));
-            
-            // Eating
-            pickup(id);
-            if (!running.load()) break; // exit early if stop was requested while waiting
-            std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 1000 + 500));
-            putdown(id);
+            std::this_thread::sleep_until(timers->next_tick());
+            expired.clear();
+            timers->advance(expired);
+            ready.push_all(expired);
+        }
+    }
+
+    void run_pool(std::vector<std::thread>& threads) {
+        int workers = opt.workers > 0 ? opt.workers : std::max(1u, std::thread::hardware_concurrency());
+        timers = std::make_unique<TimerWheel>(n, std::chrono::microseconds(opt.tick_us));
+        table->set_grant_hook([this](int id) { ready.push(id); });
+        ready.reserve(n);
+        warmed = std::make_unique<std::latch>(workers + 1);
+        if (opt.exec == ExecMode::CORO) {
+            async_table = std::make_unique<AsyncTable>(*table, ready, *timers, n);
+            for (int i = 0; i < n; i++) async_table->attach(i, coro_philosopher(i));
+        } else {
+            for (int i = 0; i < n; i++) after(i, think_time(i));
+        }
+        threads.emplace_back(&DiningPhilosophers::timer_loop, this);
+        for (int w = 0; w < workers; w++) {
+            threads.emplace_back(&DiningPhilosophers::pool_worker, this, w, workers);
+        }
+    }
+
+    void run_sim() {
+        // Single-threaded and seeded, so a run is reproducible; stops at --duration virtual
+        // seconds or after --meals meals
+        table->set_clock(&sim_now);
+        table->set_grant_hook([this](int id) { events.push(SimEvent{sim_now, sim_seq++, id}); });
+        for (int i = 0; i < n; i++) after(i, think_time(i));
+        long long end = opt.meals > 0 ? LLONG_MAX : std::llround(opt.duration_s * 1e9);
+        auto started = std::chrono::steady_clock::now();
+        reserve_samples();
+        unsigned long long allocations = heap_allocations.load(std::memory_order_relaxed);
+        unsigned long long samples = sample_allocations.load(std::memory_order_relaxed);
+        for (uint64_t handled = 1; running && !halt.raised() && !events.empty() && events.top().at <= end; handled++) {
+            SimEvent e = events.top();
+            events.pop();
+            sim_now = e.at;
+            step(e.id);
+            if (handled % sample_every == 0) {
+                table->snapshot(view);
+                sample_queue();
+            }
         }
+        run_allocations = heap_allocations.load(std::memory_order_relaxed) - allocations;
+        sample_growth = sample_allocations.load(std::memory_order_relaxed) - samples;
+        // Only a run that reached --duration lasted until end; stop(), ^C or a replay running out
+        // of recorded durations ended it at the last event
+        bool reached_end = running && !halt.raised() && replay_end.load() < 0 && (events.empty() || events.top().at > end);
+        if (opt.meals == 0 && reached_end) sim_now = end;
+        sim_wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        running = false;
     }
 
+    static constexpr uint64_t sample_every = 4096; // SIM: steps between queue depth samples
+
     void display_loop() {
         nodelay(stdscr, TRUE); // allow non-blocking key check
+        keypad(stdscr, TRUE);
         while (running) {
+            table->snapshot(view);
+            sample_queue();
+            fill_percentiles();
             {
                 std::lock_guard<std::mutex> lock(display_mutex);
-                std::lock_guard<std::mutex> state_lock(mtx);
-                clear();
-                mvprintw(0, 0, "=== Dining Philosophers (%d) ===", n);
-                mvprintw(2, 0, "Philosophers:");
-                mvprintw(3, 0, "Idx  State       Ate  Thought");
-                
-                for (int i = 0; i < n; i++) {
-                    const char* state_str = (state[i] == THINKING) ? "THINKING" : 
-                                           (state[i] == HUNGRY) ? "HUNGRY" : "EATING";
-                    mvprintw(4 + i, 0, "  %2d  %-10s  %4d  %7d", i, state_str, eat_count[i], think_count[i]);
-                }
-
-                mvprintw(5 + n, 0, "Waiting queue (front -> back):");
-                int line = 6 + n;
-                if (wait_queue.empty()) {
-                    mvprintw(line, 0, "  empty");
+                if constexpr (lock_profile) {
+                    LockProfile::Totals locks = LockProfile::totals();
+                    renderer.draw(view, table->name(), &locks);
                 } else {
-                    int col = 0;
-                    for (int id : wait_queue) {
-                        mvprintw(line, col, "%d ", id);
-                        col += 3;
-                    }
+                    renderer.draw(view, table->name());
                 }
+            }
+            int seats = 0;
+            if (renderer.handle_keys(&seats)) stop();
+            else if (seats != 0) resize(seats);
+            halt.sleep_for(std::chrono::milliseconds(400));
+            if (interrupted()) stop();
+        }
+    }
 
-                mvprintw(7 + n, 0, "Forks (between i and i+1):");
-                for (int i = 0; i < n; i++) {
-                    int owner = fork_owner[i];
-                    if (owner == -1) {
-                        mvprintw(8 + n + i, 0, "  Fork %2d-%-2d: free", i, (i + 1) % n);
-                    } else {
-                        mvprintw(8 + n + i, 0, "  Fork %2d-%-2d: held by %d", i, (i + 1) % n, owner);
-                    }
-                }
-                
-                mvprintw(9 + 2 * n + 2, 0, "Press Ctrl+C or 'q' to exit");
-                refresh();
+    // Stands in for display_loop() under --publish: the same frames, written to the stats file
+    void publish_loop() {
+        while (running) {
+            table->snapshot(view);
+            sample_queue();
+            fill_percentiles();
+            StatsFile::active->publish(view);
+            halt.sleep_for(std::chrono::milliseconds(100));
+            if (interrupted()) stop();
+        }
+    }
+
+    // Adds every wait and hold sample of the table to wait and hold, either may be null
+    void latency_totals(Histogram* wait, Histogram* hold) {
+        std::lock_guard<std::mutex> lock(spill_mutex);
+        if (wait) wait->add(spilled_wait);
+        if (hold) hold->add(spilled_hold);
+        for (int i = 0; i < n; i++) {
+            if (wait) latency[i].wait.add_to(*wait);
+            if (hold) latency[i].hold.add_to(*hold);
+        }
+    }
+
+    void fill_percentiles() {
+        view.wait_p50.resize(n);
+        view.wait_p99.resize(n);
+        view.hold_p50.resize(n);
+        view.hold_p99.resize(n);
+        for (int i = 0; i < n; i++) {
+            std::tie(view.wait_p50[i], view.wait_p99[i]) = latency[i].wait.percentiles(0.50, 0.99);
+            std::tie(view.hold_p50[i], view.hold_p99[i]) = latency[i].hold.percentiles(0.50, 0.99);
+        }
+    }
+
+    // Partitioned run: copies the view of this slice into the shared table, and once the run is
+    // over also its totals and histograms
+    void publish_partition(bool final) {
+        Partition& part = *Partition::active;
+        SharedTable& shared = part.shared;
+        if (shared.display() || final) fill_percentiles();
+        for (int i = 0; i < n; i++) {
+            SharedTable::Seat& s = shared.seat(part.first + i);
+            s.state = view.state[i];
+            int owner = view.fork_owner[i];
+            if (i > 0) s.fork_owner = owner < 0 ? -1 : part.first + owner;
+            s.eat_count = view.eat_count[i];
+            s.think_count = view.think_count[i];
+            s.queue_rank = 0;
+            if (!view.wait_p50.empty()) {
+                s.wait_p50 = view.wait_p50[i];
+                s.wait_p99 = view.wait_p99[i];
+                s.hold_p50 = view.hold_p50[i];
+                s.hold_p99 = view.hold_p99[i];
             }
-            int ch = getch();
-            if (ch == 'q' || ch == 'Q') {
-                stop();
+        }
+        for (size_t k = 0; k < view.queue.size(); k++) shared.seat(part.first + view.queue[k]).queue_rank = (int)k + 1;
+        if (!final) return;
+
+        SharedTable::Result& r = shared.result(part.index);
+        latency_totals(&r.wait, &r.hold);
+        r.meals = summary.meals;
+        r.elapsed_s = summary.elapsed_s;
+        r.wait_max_ns = std::llround(summary.wait_max_us * 1000.0);
+        r.lock_wait_ns = table->lock_wait_ns();
+        Arbiter::WaitCounts waits = table->wait_counts();
+        r.spin_hits = waits.spin_hits;
+        r.parks = waits.parks;
+        r.done.store(true, std::memory_order_release);
+    }
+
+    void bench_wait() {
+        // Runs on the main thread in place of display_loop(); stops the table once the duration is up
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(opt.duration_s);
+        reserve_samples();
+        unsigned long long allocations = heap_allocations.load(std::memory_order_relaxed);
+        unsigned long long samples = sample_allocations.load(std::memory_order_relaxed);
+        for (long tick = 1; running && (opt.meals > 0 || std::chrono::steady_clock::now() < deadline); tick++) {
+            if (!halt.sleep_for(std::chrono::milliseconds(10))) break;
+            table->snapshot(view);
+            sample_queue();
+            if (StatsFile::active && tick % 10 == 0) {
+                fill_percentiles();
+                StatsFile::active->publish(view);
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(400));
+            if (Partition::active) {
+                publish_partition(false);
+                if (Partition::active->shared.stopping()) break;
+            }
+        }
+        run_allocations = heap_allocations.load(std::memory_order_relaxed) - allocations;
+        sample_growth = sample_allocations.load(std::memory_order_relaxed) - samples;
+        stop();
+    }
+
+    static double percentile_us(const std::vector<long long>& sorted, double p) {
+        if (sorted.empty()) return 0.0;
+        size_t idx = std::min(sorted.size() - 1, (size_t)(p * (double)sorted.size()));
+        return (double)sorted[idx] / 1000.0;
+    }
+
+    void report(double elapsed_s) {
+        table->snapshot(view);
+        const std::vector<int>& eat_count = view.eat_count;
+        const std::vector<int>& think_count = view.think_count;
+
+        std::vector<long long> all, wakeups;
+        for (int i = 0; i < n; i++) {
+            all.insert(all.end(), seats[i].wait_ns.begin(), seats[i].wait_ns.end());
+            wakeups.insert(wakeups.end(), seats[i].wakeup_ns.begin(), seats[i].wakeup_ns.end());
+        }
+        std::sort(all.begin(), all.end());
+        std::sort(wakeups.begin(), wakeups.end());
+
+        Histogram hold;
+        latency_totals(nullptr, &hold);
+        int worst = 0;
+        for (int i = 0; i < n; i++) {
+            if (latency[i].wait.percentile(0.99) > latency[worst].wait.percentile(0.99)) worst = i;
+        }
+
+        // Meals are counted at putdown() so that a grant interrupted by stop() is not reported
+        long meals = 0;
+        int min_eat = eat_count[0], max_eat = eat_count[0];
+        for (int i = 0; i < n; i++) {
+            meals += think_count[i];
+            min_eat = std::min(min_eat, eat_count[i]);
+            max_eat = std::max(max_eat, eat_count[i]);
+        }
+
+        summary.arbiter = table->name();
+        summary.meals = meals;
+        summary.elapsed_s = elapsed_s;
+        summary.wall_s = opt.exec == ExecMode::SIM ? sim_wall_s : elapsed_s;
+        summary.meals_per_s = elapsed_s > 0 ? (double)meals / elapsed_s : 0.0;
+        summary.fairness = max_eat > 0 ? (double)min_eat / max_eat : 1.0;
+        summary.wait_p50_us = percentile_us(all, 0.50);
+        summary.wait_p99_us = percentile_us(all, 0.99);
+        summary.wait_p999_us = percentile_us(all, 0.999);
+        summary.wait_max_us = all.empty() ? 0.0 : (double)all.back() / 1000.0;
+        summary.hold_p99_us = (double)hold.percentile(0.99) / 1000.0;
+        summary.lock_wait_ms = (double)table->lock_wait_ns() / 1e6;
+        if (opt.quiet) return;
+
+        std::printf("=== Dining Philosophers bench (%d) ===\n", n);
+        std::printf("arbiter          %s\n", table->name());
+        if (opt.arbiter == ArbiterKind::SHARDED) std::printf("shards           %d\n", ShardedArbiter::shard_count(opt));
+        if ((opt.arbiter == ArbiterKind::MONITOR && opt.queue != QueuePolicy::FIFO) || opt.arbiter == ArbiterKind::SHARDED) std::printf("bypass           %d\n", opt.bypass_limit);
+        if (opt.arbiter == ArbiterKind::MONITOR && opt.queue == QueuePolicy::BULK) std::printf("kernel           %s\n", EligibilityKernel::best().name);
+        if (opt.arbiter == ArbiterKind::ATOMIC) std::printf("spin             %d\n", opt.spin);
+        if ((opt.arbiter == ArbiterKind::MONITOR || opt.arbiter == ArbiterKind::SHARDED) && opt.wait == WaitPolicy::ADAPTIVE) std::printf("wait             adaptive (spin limit %d us)\n", opt.spin_limit_us);
+        if (opt.exec == ExecMode::SIM) std::printf("exec             sim (virtual time, %.3f s wall, %.0f meals/sec wall)\n", sim_wall_s, sim_wall_s > 0 ? (double)meals / sim_wall_s : 0.0);
+        else if (opt.exec != ExecMode::THREADS) std::printf("exec             %s (%d workers, %d us tick)\n", opt.exec == ExecMode::POOL ? "pool" : "coro", opt.workers > 0 ? opt.workers : std::max(1u, std::thread::hardware_concurrency()), opt.tick_us);
+        else std::printf("exec             threads\n");
+        std::printf("layout           %s\n", opt.layout == Layout::PADDED ? "padded" : "packed");
+        if (Placement::active) std::printf("%s", Placement::active->describe().c_str());
+        if (Recording::active) {
+            std::printf("think, eat       replayed from %s (%s, seed %llu)\n", opt.replay_path.c_str(), Recording::active->arbiter(),
+                        (unsigned long long)Recording::active->seed());
+        } else {
+            std::printf("think            %s\n", opt.think.describe().c_str());
+            std::printf("eat              %s\n", opt.eat.describe().c_str());
+            std::printf("seed             %llu\n", (unsigned long long)opt.seed);
+        }
+        std::printf("%s", work.describe(n).c_str());
+        std::printf("elapsed          %.3f s\n", elapsed_s);
+        std::printf("meals            %ld\n", meals);
+        std::printf("meals/sec        %.0f\n", elapsed_s > 0 ? (double)meals / elapsed_s : 0.0);
+        std::printf("wait p50         %.2f us\n", percentile_us(all, 0.50));
+        std::printf("wait p99         %.2f us\n", percentile_us(all, 0.99));
+        std::printf("wait p999        %.2f us\n", percentile_us(all, 0.999));
+        std::printf("wait max         %.2f us\n", all.empty() ? 0.0 : (double)all.back() / 1000.0);
+        std::printf("woken            %zu of %zu grants made by a neighbour\n", wakeups.size(), all.size());
+        std::printf("wakeup p50       %.2f us\n", percentile_us(wakeups, 0.50));
+        std::printf("wakeup p99       %.2f us\n", percentile_us(wakeups, 0.99));
+        std::printf("wakeup p999      %.2f us\n", percentile_us(wakeups, 0.999));
+        std::printf("wakeup max       %.2f us\n", wakeups.empty() ? 0.0 : (double)wakeups.back() / 1000.0);
+        std::printf("lock wait        %.3f ms\n", (double)table->lock_wait_ns() / 1e6);
+        if constexpr (lock_profile) report_locks();
+        std::printf("allocations      %llu (%.4f per meal), and %llu growing the bench's samples\n", run_allocations,
+                    meals > 0 ? (double)run_allocations / meals : 0.0, sample_growth);
+        Arbiter::WaitCounts waits = table->wait_counts();
+        if (waits.spin_hits + waits.parks > 0) std::printf("spin hits        %ld, parks %ld\n", waits.spin_hits, waits.parks);
+        std::printf("hold p50         %.2f us\n", (double)hold.percentile(0.50) / 1000.0);
+        std::printf("hold p99         %.2f us\n", (double)hold.percentile(0.99) / 1000.0);
+        std::printf("worst wait p99   %.2f us (philosopher %d)\n", (double)latency[worst].wait.percentile(0.99) / 1000.0, worst);
+        std::printf("queue depth p50  %lld (%llu samples)\n", queue_depth.percentile(0.50), (unsigned long long)queue_depth.count());
+        std::printf("queue depth p99  %lld\n", queue_depth.percentile(0.99));
+        std::printf("queue depth max  %lld\n", queue_depth.max());
+        std::printf("eat_count min    %d\n", min_eat);
+        std::printf("eat_count max    %d\n", max_eat);
+        std::printf("fairness         %.3f (min/max)\n", max_eat > 0 ? (double)min_eat / max_eat : 1.0);
+        if (Recording::active) report_replay();
+    }
+
+    // LOCK_PROFILE: the arbiter locks split by call site, over every thread of the run
+    void report_locks() {
+        LockProfile::Totals locks = LockProfile::totals();
+        if (locks.acquisitions() == 0) return;
+        for (int k = 0; k < (int)LockSite::COUNT; k++) {
+            const LockProfile::Site& s = locks.sites[k];
+            std::printf("lock %-11s %llu acquisitions, %llu hand-offs, wait %.3f ms, hold %.3f ms\n", LockProfile::site_names[k],
+                        (unsigned long long)s.acquisitions, (unsigned long long)s.handoffs, (double)s.wait_ns / 1e6, (double)s.hold_ns / 1e6);
+        }
+    }
+
+    // How far the grant order of this run follows the recording it replays
+    void report_replay() {
+        std::vector<int> recorded, replayed = grant_order();
+        Recording::active->grant_order(recorded);
+        size_t common = std::min(recorded.size(), replayed.size());
+        size_t same = 0;
+        while (same < common && recorded[same] == replayed[same]) same++;
+        if (same == common) {
+            std::printf("grant order      as recorded for all %zu grants compared (%zu recorded, %zu replayed)\n", common,
+                        recorded.size(), replayed.size());
+        } else {
+            std::printf("grant order      as recorded for %zu grants, then philosopher %d where %d was recorded\n", same,
+                        replayed[same], recorded[same]);
+        }
+        int end = replay_end.load();
+        if (end >= 0) std::printf("replay end       philosopher %d used up its recorded durations\n", end);
+    }
+
+    // --record: writes what every philosopher drew and the grant order once the run is over
+    void save_recording() {
+        std::vector<const std::vector<uint8_t>*> streams;
+        for (int i = 0; i < n; i++) {
+            streams.push_back(&seats[i].drawn[Recording::THINK]);
+            streams.push_back(&seats[i].drawn[Recording::EAT]);
+        }
+        std::vector<int> order = grant_order();
+        if (Recording::write(opt.record_path, opt.seed, table->name(), streams, order)) {
+            notice += "record: " + std::to_string(order.size()) + " grants in " + opt.record_path + "\n";
+        } else {
+            notice += "Cannot write recording " + opt.record_path + "\n";
+        }
+    }
+
+    static void write_histogram(std::string& out, const char* name, const char* help, const Histogram& h) {
+        static const long long bounds_ns[] = {
+            1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000,
+            10000000, 25000000, 50000000, 100000000, 250000000, 500000000, 1000000000, 2500000000LL, 10000000000LL};
+        char line[160];
+        std::snprintf(line, sizeof line, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+        out += line;
+        for (long long b : bounds_ns) {
+            std::snprintf(line, sizeof line, "%s_bucket{le=\"%g\"} %llu\n", name, (double)b / 1e9, (unsigned long long)h.count_at_most(b));
+            out += line;
         }
+        std::snprintf(line, sizeof line, "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.9f\n%s_count %llu\n", name,
+                      (unsigned long long)h.count(), name, (double)h.sum() / 1e9, name, (unsigned long long)h.count());
+        out += line;
     }
 
 public:
-    DiningPhilosophers(int num) : n(num), state(num, THINKING), eat_count(num, 0), think_count(num, 0), fork_owner(num, -1), in_queue(num, false), cv(num), running(true) {
-        instance = this;
-        signal(SIGINT, handle_sigint);
-        initscr();
-        noecho();
-        cbreak();
+    // Prometheus text exposition of the live table, built from the snapshot and the histograms
+    // so that a scrape never takes an arbiter lock. Called by the exporter thread only.
+    std::string metrics() {
+        table->snapshot(scrape_view);
+        auto now = std::chrono::steady_clock::now();
+        int seated = (int)scrape_view.think_count.size(); // fewer than n while --capacity seats are empty
+        long meals = 0;
+        for (int i = 0; i < seated; i++) meals += scrape_view.think_count[i];
+        double since = std::chrono::duration<double>(now - scraped_at).count();
+        double rate = since > 0 ? (double)(meals - scraped_meals) / since : 0.0;
+        scraped_meals = meals;
+        scraped_at = now;
+
+        Histogram wait, hold;
+        latency_totals(&wait, &hold);
+
+        std::string out;
+        char line[512];
+        std::snprintf(line, sizeof line, "# HELP philosophers_meals_total Meals finished on the whole table.\n"
+                      "# TYPE philosophers_meals_total counter\nphilosophers_meals_total %ld\n", meals);
+        out += line;
+        std::snprintf(line, sizeof line, "# HELP philosophers_meals_per_second Meal rate since the previous scrape.\n"
+                      "# TYPE philosophers_meals_per_second gauge\nphilosophers_meals_per_second %.1f\n", rate);
+        out += line;
+        out += "# HELP philosophers_philosopher_meals_total Meals finished by each philosopher.\n"
+               "# TYPE philosophers_philosopher_meals_total counter\n";
+        for (int i = 0; i < seated; i++) {
+            std::snprintf(line, sizeof line, "philosophers_philosopher_meals_total{philosopher=\"%d\"} %d\n", i, scrape_view.think_count[i]);
+            out += line;
+        }
+        std::snprintf(line, sizeof line, "# HELP philosophers_queue_depth Philosophers waiting for forks.\n"
+                      "# TYPE philosophers_queue_depth gauge\nphilosophers_queue_depth %zu\n", scrape_view.queue.size());
+        out += line;
+        std::snprintf(line, sizeof line, "# HELP philosophers_lock_wait_seconds_total Time spent waiting for arbiter locks.\n"
+                      "# TYPE philosophers_lock_wait_seconds_total counter\nphilosophers_lock_wait_seconds_total %.9f\n",
+                      (double)table->lock_wait_ns() / 1e9);
+        out += line;
+        write_histogram(out, "philosophers_wait_seconds", "Time from HUNGRY to EATING.", wait);
+        write_histogram(out, "philosophers_hold_seconds", "Time forks were held, grant to putdown.", hold);
+        return out;
+    }
+
+    DiningPhilosophers(const Options& o)
+        : opt(o), n(o.capacity > 0 ? o.capacity : o.n), renderer(o.n, o.capacity > 0), running(true), seats(n, o.layout), latency(n, o.layout),
+          work(o, n) {
+        table = make_arbiter(opt, running);
+        elastic = dynamic_cast<ElasticArbiter*>(table.get());
+        if (!opt.quiet) LockProfile::reset(); // runs of --arbiter all are profiled one at a time; sweeps print no profile
+        // A partition draws the same streams as the philosophers it stands for in an unsplit ring
+        int first = Partition::active ? Partition::active->first : 0;
+        uint64_t seed = opt.seed;
+        for (int i = 0; i < first; i++) Rng::splitmix64(seed);
+        for (int i = 0; i < n; i++) {
+            seats[i].rng = Rng(Rng::splitmix64(seed));
+            seats[i].think_cursor = seats[i].eat_cursor = (size_t)(first + i); // spread philosophers over a trace
+            if (Recording::active) seats[i].think_cursor = seats[i].eat_cursor = 0; // byte offsets into the streams
+        }
+        if (!opt.quiet) {
+            instance.store(this);
+            signal(SIGINT, handle_sigint);
+        }
+        if (draws()) {
+            initscr();
+            noecho();
+            cbreak();
+        }
     }
 
     ~DiningPhilosophers() {
-        endwin();
+        DiningPhilosophers* self = this;
+        instance.compare_exchange_strong(self, nullptr);
+        if (draws()) endwin();
+        std::cerr << notice; // only once the screen is gone
     }
 
     void run() {
+        if (opt.exec == ExecMode::SIM) {
+            run_sim();
+            report((double)sim_now / 1e9);
+            if (recording()) save_recording();
+            return;
+        }
+
         std::vector<std::thread> threads;
-        
-        std::thread display(&DiningPhilosophers::display_loop, this);
-        
-        for (int i = 0; i < n; i++) {
-            threads.emplace_back(&DiningPhilosophers::philosopher, this, i);
+        auto started = std::chrono::steady_clock::now();
+
+        std::thread display;
+        if (draws()) display = std::thread(&DiningPhilosophers::display_loop, this);
+        else if (!opt.bench) display = std::thread(&DiningPhilosophers::publish_loop, this);
+
+        if (opt.exec == ExecMode::POOL || opt.exec == ExecMode::CORO) {
+            run_pool(threads);
+        } else {
+            warmed = std::make_unique<std::latch>(n);
+            for (int i = 0; i < n; i++) {
+                threads.emplace_back(&DiningPhilosophers::philosopher, this, i);
+            }
         }
-        
+
+        if (opt.bench) bench_wait();
+
         for (auto& t : threads) {
             t.join();
         }
 
-        display.join();
+        if (display.joinable()) display.join();
+        async_table.reset();
+
+        if (opt.bench) {
+            report(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+        }
+        if (Partition::active) publish_partition(true);
+        if (recording()) save_recording();
+        if (StatsFile::active) {
+            // Leave viewers the final counts; the bench report already took its snapshot
+            if (!opt.bench) table->snapshot(view);
+            fill_percentiles();
+            StatsFile::active->publish(view);
+        }
     }
 
+    const BenchSummary& result() const { return summary; }
+
+    // --capacity: seats delta more philosophers at the end of the ring (between the last one and
+    // philosopher 0), or unseats -delta from there, while the table keeps running. Their threads
+    // are started up front and wait for their seat. False if the ring would leave 5..capacity.
+    bool resize(int delta) { return elastic && elastic->grow(delta); }
+
     void stop() {
         running = false;
-        std::lock_guard<std::mutex> lock(mtx);
-        for (auto& c : cv) {
-            c.notify_all();
+        halt.raise();
+        table->stop();
+        ready.close();
+    }
+};
+
+std::atomic<DiningPhilosophers*> DiningPhilosophers::instance{nullptr};
+
+// Work-stealing job scheduler for the sweep: every worker owns a deque of job indices, runs jobs
+// from its back and, once it is empty, steals from the front of the others' deques. Jobs never
+// spawn jobs, so a worker that finds every deque empty is done.
+class JobQueues {
+public:
+    JobQueues(int workers, int jobs) : queues(workers) {
+        for (int j = 0; j < jobs; j++) queues[j % workers].jobs.push_back(j);
+    }
+
+    bool next(int worker, int& job) {
+        {
+            Queue& own = queues[worker];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            if (!own.jobs.empty()) {
+                job = own.jobs.back();
+                own.jobs.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            Queue& victim = queues[(worker + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mtx);
+            if (!victim.jobs.empty()) {
+                job = victim.jobs.front();
+                victim.jobs.pop_front();
+                return true;
+            }
         }
+        return false;
     }
+
+private:
+    struct alignas(cache_line) Queue {
+        std::mutex mtx;
+        std::deque<int> jobs;
+    };
+
+    std::vector<Queue> queues;
 };
 
-DiningPhilosophers* DiningPhilosophers::instance = nullptr;
+static std::string csv_field(const std::string& text) {
+    if (text.find_first_of(",\"\n") == std::string::npos) return text;
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Runs every combination of n, think, eat and arbiter on the SIM engine, jobs at a time, and
+// streams one CSV row per finished run to out in completion order
+static int run_sweep(const Options& base, const std::vector<int>& ns, const std::vector<Distribution>& thinks,
+                     const std::vector<Distribution>& eats, const std::vector<ArbiterKind>& arbiters, int jobs, FILE* out) {
+    std::vector<Options> runs;
+    for (int n : ns) {
+        for (const Distribution& think : thinks) {
+            for (const Distribution& eat : eats) {
+                for (ArbiterKind kind : arbiters) {
+                    Options o = base;
+                    o.n = n;
+                    o.think = think;
+                    o.eat = eat;
+                    o.arbiter = kind;
+                    runs.push_back(o);
+                }
+            }
+        }
+    }
+    if (jobs <= 0) jobs = (int)std::max(1u, std::thread::hardware_concurrency());
+    jobs = std::min(jobs, (int)runs.size());
+
+    std::fprintf(out, "run,n,arbiter,think,eat,seed,virtual_s,meals,meals_per_s,fairness,"
+                      "wait_p50_us,wait_p99_us,wait_p999_us,wait_max_us,hold_p99_us,wall_s\n");
+    std::fflush(out);
+    std::mutex out_mtx;
+    JobQueues queues(jobs, (int)runs.size());
+    std::vector<std::thread> workers;
+    for (int w = 0; w < jobs; w++) {
+        workers.emplace_back([&, w] {
+            int job;
+            while (queues.next(w, job)) {
+                const Options& o = runs[job];
+                DiningPhilosophers dp(o);
+                dp.run();
+                const BenchSummary& r = dp.result();
+                std::lock_guard<std::mutex> lock(out_mtx);
+                std::fprintf(out, "%d,%d,%s,%s,%s,%llu,%.3f,%ld,%.1f,%.4f,%.2f,%.2f,%.2f,%.2f,%.2f,%.3f\n", job, o.n,
+                             r.arbiter.c_str(), csv_field(o.think.describe()).c_str(), csv_field(o.eat.describe()).c_str(),
+                             (unsigned long long)o.seed, r.elapsed_s, r.meals, r.meals_per_s, r.fairness, r.wait_p50_us,
+                             r.wait_p99_us, r.wait_p999_us, r.wait_max_us, r.hold_p99_us, r.wall_s);
+                std::fflush(out);
+            }
+        });
+    }
+    for (auto& t : workers) t.join();
+    return 0;
+}
+
+// Ring sizes for a sweep: a comma list of N, LO..HI*F (geometric) or LO..HI+S (arithmetic)
+static std::vector<int> parse_counts(const std::string& text) {
+    std::vector<int> counts;
+    std::string item;
+    std::stringstream items(text);
+    while (std::getline(items, item, ',')) {
+        size_t dots = item.find("..");
+        if (dots == std::string::npos) {
+            counts.push_back(std::stoi(item));
+            continue;
+        }
+        size_t step_at = item.find_first_of("*+", dots);
+        if (step_at == std::string::npos) throw std::invalid_argument("range needs *F or +S in " + item);
+        int lo = std::stoi(item.substr(0, dots)), hi = std::stoi(item.substr(dots + 2, step_at - dots - 2));
+        int step = std::stoi(item.substr(step_at + 1));
+        bool geometric = item[step_at] == '*';
+        if (lo < 1 || step < (geometric ? 2 : 1)) throw std::invalid_argument("bad range " + item);
+        for (long long v = lo; v <= hi; v = geometric ? v * step : v + step) counts.push_back((int)v);
+    }
+    if (counts.empty()) throw std::invalid_argument("no ring sizes in " + text);
+    return counts;
+}
+
+// Whole-ring view assembled from what the partitions published last
+static void read_partitions(SharedTable& shared, TableView& view) {
+    int n = shared.size();
+    view.state.resize(n);
+    view.eat_count.resize(n);
+    view.think_count.resize(n);
+    view.fork_owner.resize(n);
+    view.wait_p50.resize(n);
+    view.wait_p99.resize(n);
+    view.hold_p50.resize(n);
+    view.hold_p99.resize(n);
+    std::vector<std::pair<int, int>>& order = view.ranked;
+    order.clear();
+    for (int i = 0; i < n; i++) {
+        SharedTable::Seat& s = shared.seat(i);
+        view.state[i] = s.state;
+        view.fork_owner[i] = s.fork_owner;
+        view.eat_count[i] = s.eat_count;
+        view.think_count[i] = s.think_count;
+        view.wait_p50[i] = s.wait_p50;
+        view.wait_p99[i] = s.wait_p99;
+        view.hold_p50[i] = s.hold_p50;
+        view.hold_p99[i] = s.hold_p99;
+        if (s.queue_rank != 0) order.emplace_back(s.queue_rank, i);
+    }
+    for (int p = 0; p < shared.partitions(); p++) view.fork_owner[shared.begin(p)] = shared.fork(p).owner.load(std::memory_order_relaxed);
+    // Each partition serves its own queue, so the heads of all of them come first
+    std::sort(order.begin(), order.end());
+    view.queue.clear();
+    for (auto& w : order) view.queue.push_back(w.second);
+}
+
+static SharedTable* partitioned = nullptr; // for the parent's SIGINT handler
+
+// Splits the ring across opt.partitions child processes, each running its slice through the
+// chosen arbiter, and aggregates their display or bench results in the parent
+static int run_partitions(const Options& opt) {
+    int parts = opt.partitions;
+    std::unique_ptr<SharedTable> shared = SharedTable::open(opt.n, parts);
+    if (!shared) {
+        std::cerr << "Cannot map the shared table\n";
+        return 1;
+    }
+    shared->set_display(!opt.bench || StatsFile::active);
+
+    std::vector<pid_t> children;
+    for (int p = 0; p < parts; p++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            shared->request_stop();
+            break;
+        }
+        if (pid == 0) {
+            signal(SIGINT, SIG_IGN); // the parent turns ^C into a stop of the whole table
+            StatsFile::active = nullptr; // and publishes the whole ring
+            Partition part(*shared, p);
+            Partition::active = &part;
+            Options local = opt;
+            local.n = part.last - part.first + 1;
+            local.partitions = 1;
+            local.bench = true;
+            local.quiet = true;
+            local.samples = opt.bench; // an interactive run reports nothing, and may run for hours
+            if (opt.meals > 0) local.meals = std::max(1L, opt.meals * local.n / opt.n);
+            if (!opt.bench) local.duration_s = 1e9; // until the parent stops the table
+            {
+                DiningPhilosophers dp(local);
+                dp.run();
+            }
+            _exit(0);
+        }
+        children.push_back(pid);
+    }
+    partitioned = shared.get();
+    signal(SIGINT, [](int) { if (partitioned) partitioned->request_stop(); });
+
+    Options first = opt;
+    first.n = shared->begin(1);
+    std::atomic<bool> idle{false};
+    std::string name = make_local_arbiter(first, idle)->name();
+    TableView view;
+
+    Histogram depth;
+    auto sample = [&] {
+        read_partitions(*shared, view);
+        depth.record((long long)view.queue.size());
+        view.depth_p50 = depth.percentile(0.50);
+        view.depth_p99 = depth.percentile(0.99);
+    };
+    if (StatsFile::active) {
+        while (!shared->stopping()) {
+            sample();
+            StatsFile::active->publish(view);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    } else if (!opt.bench) {
+        initscr();
+        noecho();
+        cbreak();
+        nodelay(stdscr, TRUE);
+        keypad(stdscr, TRUE);
+        Renderer renderer(opt.n);
+        std::string title = name + " x" + std::to_string(parts);
+        while (!shared->stopping()) {
+            sample();
+            renderer.draw(view, title.c_str());
+            if (renderer.handle_keys()) shared->request_stop();
+            std::this_thread::sleep_for(std::chrono::milliseconds(400));
+        }
+        endwin();
+    }
+
+    int failed = parts - (int)children.size();
+    for (pid_t pid : children) {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) failed++;
+    }
+    partitioned = nullptr;
+    if (StatsFile::active) {
+        sample();
+        StatsFile::active->publish(view);
+    }
+    if (failed > 0) {
+        std::cerr << failed << " of " << parts << " partitions failed\n";
+        return 1;
+    }
+    if (!opt.bench) return 0;
+
+    read_partitions(*shared, view);
+    Histogram wait, hold;
+    long meals = 0, spin_hits = 0, parks = 0;
+    double elapsed_s = 0;
+    long long wait_max = 0, lock_wait = 0, boundary_wait = 0;
+    for (int p = 0; p < parts; p++) {
+        SharedTable::Result& r = shared->result(p);
+        wait.add(r.wait);
+        hold.add(r.hold);
+        meals += r.meals;
+        elapsed_s = std::max(elapsed_s, r.elapsed_s.load());
+        wait_max = std::max(wait_max, r.wait_max_ns.load());
+        lock_wait += r.lock_wait_ns;
+        spin_hits += r.spin_hits;
+        parks += r.parks;
+        boundary_wait += shared->fork(p).waited.load(std::memory_order_relaxed);
+    }
+    int min_eat = *std::min_element(view.eat_count.begin(), view.eat_count.end());
+    int max_eat = *std::max_element(view.eat_count.begin(), view.eat_count.end());
+
+    std::printf("=== Dining Philosophers bench (%d) ===\n", opt.n);
+    std::printf("arbiter          %s in every partition\n", name.c_str());
+    std::printf("partitions       %d processes, boundary forks in shared memory\n", parts);
+    for (int p = 0; p < parts; p++) {
+        std::printf("  %-14s philosophers %d..%d, %ld meals\n", ("partition " + std::to_string(p)).c_str(), shared->begin(p),
+                    shared->begin(p + 1) - 1, shared->result(p).meals.load());
+    }
+    std::printf("layout           %s\n", opt.layout == Layout::PADDED ? "padded" : "packed");
+    std::printf("think            %s\n", opt.think.describe().c_str());
+    std::printf("eat              %s\n", opt.eat.describe().c_str());
+    std::printf("seed             %llu\n", (unsigned long long)opt.seed);
+    std::printf("elapsed          %.3f s\n", elapsed_s);
+    std::printf("meals            %ld\n", meals);
+    std::printf("meals/sec        %.0f\n", elapsed_s > 0 ? (double)meals / elapsed_s : 0.0);
+    std::printf("wait p50         %.2f us\n", (double)wait.percentile(0.50) / 1000.0);
+    std::printf("wait p99         %.2f us\n", (double)wait.percentile(0.99) / 1000.0);
+    std::printf("wait p999        %.2f us\n", (double)wait.percentile(0.999) / 1000.0);
+    std::printf("wait max         %.2f us\n", (double)wait_max / 1000.0);
+    std::printf("lock wait        %.3f ms\n", (double)lock_wait / 1e6);
+    std::printf("boundary wait    %.3f ms over %d forks\n", (double)boundary_wait / 1e6, parts);
+    if (spin_hits + parks > 0) std::printf("spin hits        %ld, parks %ld\n", spin_hits, parks);
+    std::printf("hold p50         %.2f us\n", (double)hold.percentile(0.50) / 1000.0);
+    std::printf("hold p99         %.2f us\n", (double)hold.percentile(0.99) / 1000.0);
+    std::printf("eat_count min    %d\n", min_eat);
+    std::printf("eat_count max    %d\n", max_eat);
+    std::printf("fairness         %.3f (min/max)\n", max_eat > 0 ? (double)min_eat / max_eat : 1.0);
+    return 0;
+}
+
+static volatile sig_atomic_t viewer_quit = 0;
 
+// --view FILE: draws the table a --publish run writes to FILE, in this process's terminal.
+// Leaving with 'q' or ^C only detaches; the run goes on until it is stopped where it runs.
+static int run_viewer(const std::string& path) {
+    std::string error;
+    std::unique_ptr<StatsFile> stats = StatsFile::attach(path, error);
+    if (!stats) {
+        std::cerr << error << "\n";
+        return 1;
+    }
+    signal(SIGINT, [](int) { viewer_quit = 1; });
+
+    initscr();
+    noecho();
+    cbreak();
+    nodelay(stdscr, TRUE);
+    keypad(stdscr, TRUE);
+    Renderer renderer(stats->size());
+    TableView view;
+    bool finished = false, lost = false;
+    while (!viewer_quit) {
+        finished = stats->finished();
+        lost = !finished && !stats->publisher_alive();
+        if (stats->read(view)) renderer.draw(view, stats->name());
+        if (finished || lost || renderer.handle_keys()) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    }
+    endwin();
+    if (finished) std::cerr << "The run publishing " << path << " has finished\n";
+    else if (lost) std::cerr << "The run publishing " << path << " exited without finishing\n";
+    return 0;
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <number_of_philosophers> [options]\n";
+    std::cerr << "Number of philosophers must be >= 5\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --bench           headless run, prints a throughput/latency report\n";
+    std::cerr << "  --duration SEC    bench length in seconds (default 5)\n";
+    std::cerr << "  --meals M         stop the bench after M meals in total instead\n";
+    std::cerr << "  --think DIST      think time: fixed:D, uniform:LO:HI, exp:MEAN or trace:FILE\n";
+    std::cerr << "                    (default uniform:1s:3s, bench default fixed:0); D is 250us, 2ms, 1s...\n";
+    std::cerr << "  --eat DIST        eat time, same forms (default uniform:500ms:1500ms, bench default fixed:0)\n";
+    std::cerr << "  --think-us US     shorthand for --think fixed:US\n";
+    std::cerr << "  --eat-us US       shorthand for --eat fixed:US\n";
+    std::cerr << "  --pin             pin philosophers (pool: workers) so ring segments share a core,\n";
+    std::cerr << "                    cache and NUMA node, and move their records to that node\n";
+    std::cerr << "  --layout packed|padded  per-philosopher records back to back, or one per cache line (default)\n";
+    std::cerr << "  --seed S          seed for the per-philosopher generators (default: from the clock)\n";
+    std::cerr << "  --queue fifo|scan|bulk  serve the wait queue from the front only, or grant every free\n";
+    std::cerr << "                    waiter; bulk finds them with a bitmask pass (AVX2/AVX-512 where available)\n";
+    std::cerr << "  --bypass K        scan/sharded: times a waiter may be overtaken by a neighbour (default 4)\n";
+    std::cerr << "  --arbiter NAME    monitor (one lock, default), sharded (one lock per ring segment)\n";
+    std::cerr << "                    atomic (CAS on fork words, no lock), hierarchy (fork locks in\n";
+    std::cerr << "                    index order), waiter (fork locks behind n-1 seat tokens) or\n";
+    std::cerr << "                    chandy-misra (dirty/clean forks handed over on request),\n";
+    std::cerr << "                    fixed (the fifo monitor compiled for n = 5, 64 or 1024);\n";
+    std::cerr << "                    all runs each in turn with --bench and prints a comparison\n";
+    std::cerr << "  --shards S        sharded: number of ring segments (default 8, at most n/6)\n";
+    std::cerr << "  --spin N          atomic: claim attempts before parking (default 200)\n";
+    std::cerr << "  --wait park|adaptive  monitor/sharded: park at once (default) or spin first for the\n";
+    std::cerr << "                    neighbours' recent hold time when there is a free core\n";
+    std::cerr << "  --spin-limit-us US  adaptive: park at once when longer holds are expected (default 50)\n";
+    std::cerr << "  --exec MODE       threads (one thread per philosopher, default), pool (state machines\n";
+    std::cerr << "                    on a worker pool), coro (coroutines on a worker pool) or sim (pool\n";
+    std::cerr << "                    state machines on one thread in virtual time; --duration is virtual)\n";
+    std::cerr << "  --workers W       pool/coro: worker threads (default: one per core)\n";
+    std::cerr << "  --tick-us US      pool/coro: timer wheel resolution (default 100)\n";
+    std::cerr << "  --trace FILE      record every state change, grant and queue push/pop to FILE\n";
+    std::cerr << "  --metrics-port P  serve Prometheus metrics at http://HOST:P/metrics while running\n";
+    std::cerr << "  --partitions P    split the ring into P processes that run their slice with the\n"
+                 "                    chosen arbiter and share only the boundary forks (threads only)\n";
+    std::cerr << "  --publish FILE    draw nothing; publish the live table to FILE for --view instead\n";
+    std::cerr << "  --record FILE     save every think/eat duration drawn and the grant order to FILE\n";
+    std::cerr << "  --replay FILE     take think/eat durations from a --record file, on any engine, until one\n";
+    std::cerr << "                    philosopher runs out, and report where the grant order departs from it\n";
+    std::cerr << "  --work KIND       what eating does for the eat time: sleep (default), spin (busy CPU loop)\n";
+    std::cerr << "                    or touch[:SIZE] (write every cache line of both forks' SIZE buffers,\n";
+    std::cerr << "                    default 4k, at least once per meal); --eat trace:FILE drives either\n";
+    std::cerr << "  --capacity C      seats for up to C philosophers; '+' and '-' add and remove one at the\n";
+    std::cerr << "                    end of the ring while it runs (interactive table, --exec threads)\n";
+    std::cerr << "Usage: " << prog << " --view FILE\n";
+    std::cerr << "  draws the table a --publish run writes to FILE; 'q' detaches without stopping it\n";
+    std::cerr << "Usage: " << prog << " --sweep SIZES [options]\n";
+    std::cerr << "  runs every combination of SIZES (5,64,1024 or 5..1280*2 or 10..100+10), each --think,\n";
+    std::cerr << "  --eat and --arbiter given (default: monitor, sharded, chandy-misra) in virtual time,\n";
+    std::cerr << "  in parallel, and streams one CSV row per run\n";
+    std::cerr << "  --jobs J          simulations run at once (default: one per core)\n";
+    std::cerr << "  --out FILE        write the CSV to FILE instead of stdout\n";
+    std::cerr << "Usage: " << prog << " --trace-convert TRACE JSON\n";
+    std::cerr << "  writes a --trace file as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)\n";
+}
+
+// Compiled out when the benchmarks in bench/ include this file
+#ifndef FILOZOFOWIE_NO_MAIN
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <number_of_philosophers>\n";
-        std::cerr << "Number of philosophers must be >= 5\n";
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (argc == 4 && std::strcmp(argv[1], "--trace-convert") == 0) {
+        return convert_trace(argv[2], argv[3]) ? 0 : 1;
+    }
+    if (argc == 3 && std::strcmp(argv[1], "--view") == 0) {
+        return run_viewer(argv[2]);
+    }
+
+    // A sweep takes a list of ring sizes in place of n, and every --think, --eat and --arbiter
+    // given adds a value to its axis instead of replacing the previous one
+    bool sweep = argc >= 3 && std::strcmp(argv[1], "--sweep") == 0;
+    std::vector<int> sweep_n;
+    std::vector<Distribution> sweep_think, sweep_eat;
+    std::vector<ArbiterKind> sweep_arbiters;
+    int sweep_jobs = 0;
+    std::string sweep_out;
+
+    Options opt;
+    bool think_set = false, eat_set = false, duration_set = false;
+    try {
+        if (sweep) sweep_n = parse_counts(argv[2]);
+        else sweep_n.push_back(std::stoi(argv[1]));
+        opt.n = sweep_n.front();
+        for (int a = sweep ? 3 : 2; a < argc; a++) {
+            std::string arg = argv[a];
+            auto value = [&]() -> std::string {
+                if (a + 1 >= argc) throw std::invalid_argument(arg + " needs a value");
+                return argv[++a];
+            };
+            if (arg == "--bench") opt.bench = true;
+            else if (arg == "--duration") { opt.duration_s = std::stod(value()); duration_set = true; }
+            else if (arg == "--meals") opt.meals = std::stol(value());
+            else if (arg == "--think") { opt.think = Distribution::parse(value()); think_set = true; sweep_think.push_back(opt.think); }
+            else if (arg == "--eat") { opt.eat = Distribution::parse(value()); eat_set = true; sweep_eat.push_back(opt.eat); }
+            else if (arg == "--think-us") { opt.think = Distribution::fixed(parse_duration_ns(value() + "us")); think_set = true; sweep_think.push_back(opt.think); }
+            else if (arg == "--eat-us") { opt.eat = Distribution::fixed(parse_duration_ns(value() + "us")); eat_set = true; sweep_eat.push_back(opt.eat); }
+            else if (arg == "--jobs" && sweep) sweep_jobs = std::stoi(value());
+            else if (arg == "--out" && sweep) sweep_out = value();
+            else if (arg == "--seed") opt.seed = std::stoull(value());
+            else if (arg == "--pin") opt.pin = true;
+            else if (arg == "--layout") {
+                std::string l = value();
+                if (l == "packed") opt.layout = Layout::PACKED;
+                else if (l == "padded") opt.layout = Layout::PADDED;
+                else throw std::invalid_argument("unknown layout " + l);
+            }
+            else if (arg == "--queue") {
+                std::string q = value();
+                if (q == "fifo") opt.queue = QueuePolicy::FIFO;
+                else if (q == "scan") opt.queue = QueuePolicy::SCAN;
+                else if (q == "bulk") opt.queue = QueuePolicy::BULK;
+                else throw std::invalid_argument("unknown queue policy " + q);
+            }
+            else if (arg == "--bypass") opt.bypass_limit = std::stoi(value());
+            else if (arg == "--arbiter") {
+                std::string a = value();
+                if (a == "monitor") opt.arbiter = ArbiterKind::MONITOR;
+                else if (a == "sharded") opt.arbiter = ArbiterKind::SHARDED;
+                else if (a == "atomic") opt.arbiter = ArbiterKind::ATOMIC;
+                else if (a == "hierarchy") opt.arbiter = ArbiterKind::HIERARCHY;
+                else if (a == "waiter") opt.arbiter = ArbiterKind::WAITER;
+                else if (a == "chandy-misra") opt.arbiter = ArbiterKind::CHANDY_MISRA;
+                else if (a == "fixed") opt.arbiter = ArbiterKind::FIXED;
+                else if (a == "all") opt.all_arbiters = true;
+                else throw std::invalid_argument("unknown arbiter " + a);
+                if (a != "all") sweep_arbiters.push_back(opt.arbiter);
+            }
+            else if (arg == "--shards") opt.shards = std::stoi(value());
+            else if (arg == "--spin") opt.spin = std::stoi(value());
+            else if (arg == "--wait") {
+                std::string w = value();
+                if (w == "park") opt.wait = WaitPolicy::PARK;
+                else if (w == "adaptive") opt.wait = WaitPolicy::ADAPTIVE;
+                else throw std::invalid_argument("unknown wait policy " + w);
+            }
+            else if (arg == "--spin-limit-us") opt.spin_limit_us = std::stoi(value());
+            else if (arg == "--exec") {
+                std::string e = value();
+                if (e == "threads") opt.exec = ExecMode::THREADS;
+                else if (e == "pool") opt.exec = ExecMode::POOL;
+                else if (e == "coro") opt.exec = ExecMode::CORO;
+                else if (e == "sim") opt.exec = ExecMode::SIM;
+                else throw std::invalid_argument("unknown exec mode " + e);
+            }
+            else if (arg == "--workers") opt.workers = std::stoi(value());
+            else if (arg == "--tick-us") opt.tick_us = std::stoi(value());
+            else if (arg == "--trace") opt.trace_path = value();
+            else if (arg == "--metrics-port") opt.metrics_port = std::stoi(value());
+            else if (arg == "--partitions") opt.partitions = std::stoi(value());
+            else if (arg == "--publish") opt.publish_path = value();
+            else if (arg == "--record") opt.record_path = value();
+            else if (arg == "--replay") opt.replay_path = value();
+            else if (arg == "--capacity") opt.capacity = std::stoi(value());
+            else if (arg == "--work") {
+                std::string w = value();
+                if (w == "sleep") opt.work = WorkKind::SLEEP;
+                else if (w == "spin") opt.work = WorkKind::SPIN;
+                else if (w == "touch") opt.work = WorkKind::TOUCH;
+                else if (w.rfind("touch:", 0) == 0) {
+                    opt.work = WorkKind::TOUCH;
+                    opt.touch_bytes = parse_bytes(w.substr(6));
+                }
+                else throw std::invalid_argument("unknown workload " + w);
+            }
+            else throw std::invalid_argument("unknown option " + arg);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        usage(argv[0]);
         return 1;
     }
 
-    int n = std::stoi(argv[1]);
-    if (n < 5) {
+    if (*std::min_element(sweep_n.begin(), sweep_n.end()) < 5) {
         std::cerr << "Number of philosophers must be at least 5\n";
         return 1;
     }
+    if (sweep) {
+        // Sweeps only make sense in virtual time, where runs are independent of each other and of the machine
+        opt.exec = ExecMode::SIM;
+        opt.bench = true;
+        opt.quiet = true;
+        if (opt.pin || !opt.trace_path.empty() || opt.metrics_port != 0) {
+            // The runs go on at once, and tracing, pinning and metrics each serve one table
+            std::cerr << "--sweep cannot be combined with --pin, --trace or --metrics-port\n";
+            return 1;
+        }
+        if (opt.all_arbiters || sweep_arbiters.empty()) {
+            sweep_arbiters = {ArbiterKind::MONITOR, ArbiterKind::SHARDED, ArbiterKind::CHANDY_MISRA};
+            opt.all_arbiters = false;
+        }
+        for (ArbiterKind kind : sweep_arbiters) {
+            if (blocking_only(kind)) {
+                std::cerr << "A sweep runs in virtual time; atomic, hierarchy and waiter need --exec threads\n";
+                return 1;
+            }
+            if (kind == ArbiterKind::FIXED && !std::all_of(sweep_n.begin(), sweep_n.end(), fixed_size)) {
+                std::cerr << "--arbiter fixed is only built for 5, 64 and 1024 philosophers\n";
+                return 1;
+            }
+        }
+    }
+    if (std::find(sweep_arbiters.begin(), sweep_arbiters.end(), ArbiterKind::FIXED) != sweep_arbiters.end()) {
+        if (!sweep && !fixed_size(opt.n)) {
+            std::cerr << "--arbiter fixed is only built for 5, 64 and 1024 philosophers\n";
+            return 1;
+        }
+        if (opt.queue != QueuePolicy::FIFO || opt.wait != WaitPolicy::PARK || opt.partitions != 1) {
+            std::cerr << "--arbiter fixed is the fifo monitor with --wait park and cannot be partitioned\n";
+            return 1;
+        }
+    }
+    if (opt.work != WorkKind::SLEEP && (opt.exec == ExecMode::SIM || opt.partitions != 1 || opt.touch_bytes == 0)) {
+        // Busy eating takes real time, and forks shared between partitions have no common buffer
+        std::cerr << "--work spin and touch need real time and one process (not --exec sim, --sweep or --partitions),\n"
+                     "and touch a buffer of at least one byte\n";
+        return 1;
+    }
+    if (opt.work == WorkKind::TOUCH) {
+        // Every fork's buffer is allocated and zeroed up front
+        size_t forks = (size_t)(opt.capacity > 0 ? opt.capacity : opt.n);
+        size_t half = (size_t)sysconf(_SC_PHYS_PAGES) * (size_t)sysconf(_SC_PAGESIZE) / 2;
+        if (opt.touch_bytes > half / forks) {
+            std::cerr << "--work touch buffers of " << forks << " forks may take at most half the memory, "
+                      << half / forks << " bytes each\n";
+            return 1;
+        }
+    }
+    if (opt.exec == ExecMode::SIM) {
+        // Virtual time costs nothing to wait through, so the simulation keeps the interactive
+        // defaults and --duration counts virtual seconds
+        if (!opt.bench) {
+            std::cerr << "--exec sim runs headless; add --bench\n";
+            return 1;
+        }
+        // A sweep runs every think x eat pair, so any one of them with no time at all would never end
+        auto instant = [](const Distribution& d) { return d.kind == Distribution::FIXED && d.lo_ns == 0; };
+        std::vector<Distribution> thinks = sweep && !sweep_think.empty() ? sweep_think : std::vector<Distribution>{opt.think};
+        std::vector<Distribution> eats = sweep && !sweep_eat.empty() ? sweep_eat : std::vector<Distribution>{opt.eat};
+        bool stalls = false;
+        for (const Distribution& think : thinks) {
+            for (const Distribution& eat : eats) stalls = stalls || (instant(think) && instant(eat));
+        }
+        if (opt.meals == 0 && stalls) {
+            std::cerr << "With zero think and eat time virtual time never advances; use --meals\n";
+            return 1;
+        }
+    } else if (opt.bench) {
+        // The bench measures arbitration, so by default philosophers go straight back to the table
+        if (!think_set) opt.think = Distribution::fixed(0);
+        if (!eat_set) opt.eat = Distribution::fixed(0);
+    }
+    if (opt.seed == 0) opt.seed = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    if (opt.duration_s <= 0 || opt.meals < 0 || opt.bypass_limit < 0 || opt.shards < 1 || opt.spin < 0 || opt.spin_limit_us < 0 || opt.workers < 0 || opt.tick_us < 1 || opt.metrics_port < 0 || opt.metrics_port > 65535) {
+        std::cerr << "Bench times and counts must not be negative\n";
+        return 1;
+    }
+
+    if (opt.all_arbiters && (!opt.bench || opt.metrics_port != 0)) {
+        std::cerr << "--arbiter all needs --bench and cannot be combined with --metrics-port\n";
+        return 1;
+    }
+    if (!opt.publish_path.empty() && (sweep || opt.all_arbiters || opt.exec == ExecMode::SIM)) {
+        std::cerr << "--publish needs a single live run; it cannot be combined with --sweep, --arbiter all or --exec sim\n";
+        return 1;
+    }
+    if (opt.partitions != 1) {
+        if (opt.partitions < 2 || opt.n / opt.partitions < 5) {
+            std::cerr << "--partitions needs at least 2 partitions of at least 5 philosophers each\n";
+            return 1;
+        }
+        if (sweep || opt.all_arbiters || opt.exec != ExecMode::THREADS || opt.pin || !opt.trace_path.empty() || opt.metrics_port != 0) {
+            std::cerr << "--partitions runs --exec threads and cannot be combined with --sweep, --arbiter all, --pin, --trace or --metrics-port\n";
+            return 1;
+        }
+    }
+
+    if (opt.capacity != 0) {
+        if (opt.capacity < opt.n) {
+            std::cerr << "--capacity must be at least the number of philosophers\n";
+            return 1;
+        }
+        if (opt.bench || sweep || opt.exec != ExecMode::THREADS || opt.partitions != 1 || opt.arbiter == ArbiterKind::FIXED ||
+            !opt.publish_path.empty() || !opt.record_path.empty() || !opt.replay_path.empty()) {
+            std::cerr << "--capacity resizes the interactive table with --exec threads; it cannot be combined with --bench,\n"
+                         "--partitions, --arbiter fixed, --publish, --record or --replay\n";
+            return 1;
+        }
+    }
+    int seats = opt.capacity > 0 ? opt.capacity : opt.n;
+
+    std::unique_ptr<Recording> replay;
+    if (!opt.record_path.empty() || !opt.replay_path.empty()) {
+        if (sweep || opt.all_arbiters || opt.partitions != 1 || (!opt.record_path.empty() && !opt.replay_path.empty())) {
+            std::cerr << "--record and --replay need a single unpartitioned run, and only one of them\n";
+            return 1;
+        }
+    }
+    if (!opt.replay_path.empty()) {
+        if (think_set || eat_set) {
+            std::cerr << "--replay takes think and eat times from the recording\n";
+            return 1;
+        }
+        std::string error;
+        replay = Recording::open(opt.replay_path, error);
+        if (!replay) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+        if (replay->size() != opt.n) {
+            std::cerr << opt.replay_path << " records " << replay->size() << " philosophers, not " << opt.n << "\n";
+            return 1;
+        }
+        Recording::active = replay.get();
+        if (!duration_set) opt.duration_s = 1e9; // until a philosopher runs out of recorded durations
+    }
+
+    std::unique_ptr<StatsFile> stats;
+    if (!opt.publish_path.empty()) {
+        // Titled like the run's own screen would be
+        Options first = opt;
+        first.n = opt.n / opt.partitions;
+        std::atomic<bool> idle{false};
+        std::string title = make_local_arbiter(first, idle)->name();
+        if (opt.partitions > 1) title += " x" + std::to_string(opt.partitions);
+        stats = StatsFile::create(opt.publish_path, opt.n, title);
+        if (!stats) {
+            std::cerr << "Cannot write stats file " << opt.publish_path << "\n";
+            return 1;
+        }
+        StatsFile::active = stats.get();
+        std::cerr << "publishing to " << opt.publish_path << "; attach with " << argv[0] << " --view " << opt.publish_path << "\n";
+    }
+
+    if (opt.partitions != 1) return run_partitions(opt);
+    if (opt.exec != ExecMode::THREADS && !opt.all_arbiters && blocking_only(opt.arbiter)) {
+        std::cerr << "This arbiter has no non-blocking request path; use --exec threads\n";
+        return 1;
+    }
+
+    std::unique_ptr<Tracer> tracer;
+    if (!opt.trace_path.empty()) {
+        tracer = Tracer::open(opt.trace_path, seats);
+        if (!tracer) {
+            std::cerr << "Cannot write trace " << opt.trace_path << "\n";
+            return 1;
+        }
+        Tracer::active = tracer.get();
+    }
+
+    std::unique_ptr<Placement> placement;
+    if (opt.pin) {
+        placement = std::make_unique<Placement>(Topology::detect(), seats);
+        Placement::active = placement.get();
+        std::cerr << placement->describe();
+    }
+
+    std::unique_ptr<MetricsServer> metrics;
+    if (opt.metrics_port != 0) {
+        metrics = MetricsServer::open(opt.metrics_port);
+        if (!metrics) {
+            std::cerr << "Cannot listen on port " << opt.metrics_port << "\n";
+            return 1;
+        }
+    }
+
+    if (sweep) {
+        if (sweep_think.empty()) sweep_think.push_back(opt.think);
+        if (sweep_eat.empty()) sweep_eat.push_back(opt.eat);
+        FILE* out = sweep_out.empty() ? stdout : std::fopen(sweep_out.c_str(), "w");
+        if (!out) {
+            std::cerr << "Cannot write " << sweep_out << "\n";
+            return 1;
+        }
+        run_sweep(opt, sweep_n, sweep_think, sweep_eat, sweep_arbiters, sweep_jobs, out);
+        if (out != stdout) std::fclose(out);
+    } else if (opt.all_arbiters) {
+        std::vector<BenchSummary> rows;
+        for (ArbiterKind kind : {ArbiterKind::MONITOR, ArbiterKind::FIXED, ArbiterKind::SHARDED, ArbiterKind::ATOMIC,
+                                 ArbiterKind::HIERARCHY, ArbiterKind::WAITER, ArbiterKind::CHANDY_MISRA}) {
+            if (opt.exec != ExecMode::THREADS && blocking_only(kind)) continue;
+            if (kind == ArbiterKind::FIXED && !fixed_size(opt.n)) continue;
+            Options run = opt;
+            run.arbiter = kind;
+            DiningPhilosophers dp(run);
+            dp.run();
+            rows.push_back(dp.result());
+            std::printf("\n");
+        }
+        std::printf("=== Arbiter comparison (%d) ===\n", opt.n);
+        std::printf("%-14s %12s %9s %11s %11s %11s %13s\n", "arbiter", "meals/sec", "fairness", "wait p50", "wait p99", "wait p999", "lock wait");
+        for (const BenchSummary& r : rows) {
+            std::printf("%-14s %12.0f %9.3f %8.2f us %8.2f us %8.2f us %10.3f ms\n", r.arbiter.c_str(), r.meals_per_s, r.fairness,
+                        r.wait_p50_us, r.wait_p99_us, r.wait_p999_us, r.lock_wait_ms);
+        }
+    } else {
+        DiningPhilosophers dp(opt);
+        if (metrics) metrics->start([&dp]{ return dp.metrics(); });
+        dp.run();
+        if (metrics) metrics->close();
+    }
 
-    DiningPhilosophers dp(n);
-    dp.run();
+    if (tracer) {
+        // Every philosopher has been joined, so nothing emits any more
+        Tracer::active = nullptr;
+        tracer->close();
+        std::cerr << "trace: " << tracer->written() << " events, " << tracer->dropped() << " dropped, in " << opt.trace_path << "\n";
+    }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file